@@ -0,0 +1,177 @@
+/**
+
+Startup tuning of fitness evaluation.
+
+Fastest number of threads and tile of the surface kernel depend on the
+machine and the shape of the problem. Candidates are timed on the actual
+data with a random population of the run's size and the fastest one is
+appended to a tuning file under a key made of the CPU model and the problem
+shape, so later runs of the same shape skip the calibration.
+
+Only variants giving bitwise identical fitness are candidates: every
+individual is summed by one thread in the same order whatever the thread
+count and tile, so tuning changes speed, never results. Calibration draws
+from its own generator and bypasses the fitness cache, the run is the same
+with and without it.
+
+*/
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include <omp.h>
+
+#include "config.h"
+#include "cpu_version.h"
+#include "surface.h"
+
+using namespace std;
+
+// Evaluations timed per candidate, the fastest one counts
+#define TUNE_REPEATS 3
+
+// Returns model name of the CPU from /proc/cpuinfo
+static string cpuModel()
+{
+    string model = "unknown";
+    FILE *file = fopen("/proc/cpuinfo", "r");
+    if(file == NULL)
+        return model;
+
+    char line[512];
+    while(fgets(line, sizeof(line), file) != NULL){
+        if(strncmp(line, "model name", 10) != 0)
+            continue;
+        const char *value = strchr(line, ':');
+        if(value != NULL){
+            model = value + 1 + strspn(value + 1, " \t");
+            model.erase(model.find_last_not_of(" \t\n") + 1);
+        }
+        break;
+    }
+    fclose(file);
+    return model;
+}
+
+// Key of the tuning file: CPU, available threads, problem shape and every
+// option that selects or changes the fitness kernel
+static string tuneKey(const Dataset *data, const Options *options, int size)
+{
+    char shape[512];
+    snprintf(shape, sizeof(shape), " | threads %d population %d genes %d points %lld"
+             " dims %d degree %d loss %d precision %d weights %d stats %d"
+             " stream %d chunk %d online %d window %d decay %g normalize %d"
+             " cache %lld dedup %g model ",
+             omp_get_max_threads(), size, genomeLen, (long long)datasetPoints(data),
+             options->dims, options->degree, (int)options->loss, (int)options->precision,
+             data->weights != NULL, data->stats != NULL,
+             data->stream != NULL, data->stream != NULL ? options->chunkPoints : 0,
+             options->online, options->window, options->decay, options->normalize,
+             options->fitnessCache, options->dedupEpsilon);
+    string key = cpuModel() + shape;
+    key += options->modelExpression != NULL ? options->modelExpression : "polynomial";
+    return key;
+}
+
+// Looks up @key in tuning file, false if the file or the key is missing
+static bool readTuning(const char *file, const string &key, int *threads, int *tile)
+{
+    FILE *in = fopen(file, "r");
+    if(in == NULL)
+        return false;
+
+    //threads tile key, one entry per line, the last one wins
+    bool found = false;
+    char line[1024];
+    while(fgets(line, sizeof(line), in) != NULL){
+        int t, s, offset;
+        if(sscanf(line, "%d %d %n", &t, &s, &offset) != 2)
+            continue;
+        string lineKey = line + offset;
+        lineKey.erase(lineKey.find_last_not_of("\n") + 1);
+        if(lineKey == key && t > 0 && s > 0 && s <= SURFACE_MAX_TILE){
+            *threads = t;
+            *tile = s;
+            found = true;
+        }
+    }
+    fclose(in);
+    return found;
+}
+
+// Seconds of the fastest of TUNE_REPEATS evaluations of @population
+static double timeEvaluation(const Dataset *data, float *population, int size,
+                             float *fitnesses)
+{
+    double best = INFINITY;
+    for(int r=0; r<TUNE_REPEATS; r++){
+        double t = omp_get_wtime();
+        evaluate(data, population, size, fitnesses);
+        best = min(best, omp_get_wtime() - t);
+    }
+    return best;
+}
+
+void autotune(const char *file, const Dataset *data, const Options *options)
+{
+    int size = options->populationSize;
+    string key = tuneKey(data, options, size);
+    int threads = omp_get_max_threads();
+    int tile = surfaceTile;
+
+    if(readTuning(file, key, &threads, &tile)){
+        omp_set_num_threads(threads);
+        surfaceTile = tile;
+        cout << "Autotune - threads: " << threads << " surface tile: " << tile
+             << " (from " << file << ")" << endl;
+        return;
+    }
+
+    //random population of the run's size from a private generator
+    Rng rng;
+    seedRng(&rng, 1);
+    float *population = new float[size*genomeLen];
+    float *fitnesses = new float[size];
+    for(int i=0; i<size*genomeLen; i++)
+        population[i] = rngUniform(&rng)*10 - 5;
+
+    Dataset uncached = *data;
+    uncached.cache = NULL;
+
+    //thread counts are powers of two and all available threads
+    int maxThreads = omp_get_max_threads();
+    double bestTime = INFINITY;
+    for(int t=1; ; t = min(2*t, maxThreads)){
+        int tiles = data->surface != NULL ? SURFACE_MAX_TILE : 1;
+        for(int s=1; s<=tiles; s*=2){
+            omp_set_num_threads(t);
+            surfaceTile = data->surface != NULL ? s : tile;
+            double time = timeEvaluation(&uncached, population, size, fitnesses);
+            if(time < bestTime){
+                bestTime = time;
+                threads = t;
+                tile = surfaceTile;
+            }
+        }
+        if(t == maxThreads)
+            break;
+    }
+    omp_set_num_threads(threads);
+    surfaceTile = tile;
+
+    delete [] population;
+    delete [] fitnesses;
+
+    FILE *out = fopen(file, "a");
+    if(out != NULL){
+        fprintf(out, "%d %d %s\n", threads, tile, key.c_str());
+        fclose(out);
+    }else
+        cerr << "Error while writing tuning file " << file << "!!!" << endl;
+
+    cout << "Autotune - threads: " << threads << " surface tile: " << tile
+         << " evaluation: " << bestTime << " s" << endl;
+}
@@ -0,0 +1,236 @@
+/**
+
+Checkpoint and restart of the GA state.
+
+State of the GA is copied into snapshot buffer and written by helper thread,
+so the GA loop continues while the file is being written. File is written
+under temporary name and renamed when complete, so the previous checkpoint
+stays valid if the run is killed in the middle of writing.
+
+*/
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "config.h"
+#include "cpu_version.h"
+#include "checkpoint.h"
+
+using namespace std;
+
+static_assert(ENGINE_GA == CHECKPOINT_ENGINE_GA, "MPI checkpoints are GA checkpoints");
+static_assert(PHASE_COUNT <= CHECKPOINT_PHASES, "phase times do not fit into checkpoint");
+
+struct CheckpointWriter
+{
+    string fileName;
+    CheckpointHeader header;    // snapshot of the state
+    float *population;
+    float *fitnesses;
+    float *steps;
+    int capacity;               // number of individuals snapshot buffers can hold
+    char *engineState;          // serialized CMA-ES and swarm states
+    int engineCapacity;         // bytes engineState can hold
+    thread writer;
+    bool failed;                // last write failed
+};
+
+CheckpointWriter *createCheckpointWriter(const char *fileName)
+{
+    CheckpointWriter *checkpoint = new CheckpointWriter;
+    checkpoint->fileName = fileName;
+    checkpoint->population = NULL;
+    checkpoint->fitnesses = NULL;
+    checkpoint->steps = NULL;
+    checkpoint->capacity = 0;
+    checkpoint->engineState = NULL;
+    checkpoint->engineCapacity = 0;
+    checkpoint->failed = false;
+    return checkpoint;
+}
+
+// Waits until previous checkpoint is written
+static void waitCheckpoint(CheckpointWriter *checkpoint)
+{
+    if(checkpoint->writer.joinable())
+        checkpoint->writer.join();
+
+    if(checkpoint->failed){
+        cerr << "Error while writing checkpoint " << checkpoint->fileName << "!!!" << endl;
+        checkpoint->failed = false;
+    }
+}
+
+// Writes snapshot into the file, runs in helper thread
+static void writeSnapshot(CheckpointWriter *checkpoint)
+{
+    string tmpName = checkpoint->fileName + ".tmp";
+    FILE *file = fopen(tmpName.c_str(), "wb");
+    if(file == NULL){
+        checkpoint->failed = true;
+        return;
+    }
+
+    int size = checkpoint->header.populationSize;
+    size_t engineBytes = checkpoint->header.cmaBytes + checkpoint->header.psoBytes;
+    bool ok = fwrite(&checkpoint->header, sizeof(CheckpointHeader), 1, file) == 1
+        && fwrite(checkpoint->population, sizeof(float), size*genomeLen, file)
+           == (size_t)size*genomeLen
+        && fwrite(checkpoint->fitnesses, sizeof(float), size, file) == (size_t)size
+        && fwrite(checkpoint->steps, sizeof(float), size*genomeLen, file)
+           == (size_t)size*genomeLen
+        && fwrite(checkpoint->engineState, 1, engineBytes, file) == engineBytes
+        && fflush(file) == 0
+        && fsync(fileno(file)) == 0;
+    ok = fclose(file) == 0 && ok;
+
+    //replace previous checkpoint only by complete one
+    if(!ok || rename(tmpName.c_str(), checkpoint->fileName.c_str()) != 0){
+        unlink(tmpName.c_str());
+        checkpoint->failed = true;
+    }
+}
+
+void writeCheckpoint(CheckpointWriter *checkpoint, const GAState *state,
+                     Engine engine)
+{
+    //snapshot buffers are still used by the previous write
+    waitCheckpoint(checkpoint);
+
+    if(checkpoint->capacity < state->size){
+        delete [] checkpoint->population;
+        delete [] checkpoint->fitnesses;
+        delete [] checkpoint->steps;
+        checkpoint->capacity = state->size;
+        checkpoint->population = new float[state->size*genomeLen];
+        checkpoint->fitnesses = new float[state->size];
+        checkpoint->steps = new float[state->size*genomeLen];
+    }
+
+    int cmaBytes = state->cma != NULL ? cmaStateBytes(state->cma) : 0;
+    int psoBytes = state->pso != NULL ? psoStateBytes(state->pso) : 0;
+    if(checkpoint->engineCapacity < cmaBytes + psoBytes){
+        delete [] checkpoint->engineState;
+        checkpoint->engineCapacity = cmaBytes + psoBytes;
+        checkpoint->engineState = new char[cmaBytes + psoBytes];
+    }
+    if(state->cma != NULL)
+        saveCMAState(state->cma, checkpoint->engineState);
+    if(state->pso != NULL)
+        savePSOState(state->pso, checkpoint->engineState + cmaBytes);
+
+    CheckpointHeader *header = &checkpoint->header;
+    header->magic = CHECKPOINT_MAGIC;
+    header->version = CHECKPOINT_VERSION;
+    header->engine = engine;
+    header->populationSize = state->size;
+    header->individualLen = genomeLen;
+    header->generationNumber = state->generationNumber;
+    header->noChangeIter = state->noChangeIter;
+    header->bestFitness = state->bestFitness;
+    header->previousBestFitness = state->previousBestFitness;
+    header->rngState = globalRng.state;
+    header->evaluations = state->evaluations;
+    header->duplicates = state->duplicates;
+    for(int p=0; p<CHECKPOINT_PHASES; p++)
+        header->phaseTimes[p] = p < PHASE_COUNT ? state->phaseTimes[p] : 0;
+    header->restarts = state->restarts;
+    header->mutationScale = state->mutationScale;
+    header->deMeanF = state->deMeanF;
+    header->deMeanCR = state->deMeanCR;
+    header->stepsStored = 1;
+    header->cmaBytes = cmaBytes;
+    header->psoBytes = psoBytes;
+
+    memcpy(checkpoint->population, state->population,
+           state->size*genomeLen*sizeof(float));
+    memcpy(checkpoint->fitnesses, state->fitnesses, state->size*sizeof(float));
+    memcpy(checkpoint->steps, state->steps, state->size*genomeLen*sizeof(float));
+
+    checkpoint->writer = thread(writeSnapshot, checkpoint);
+}
+
+void freeCheckpointWriter(CheckpointWriter *checkpoint)
+{
+    waitCheckpoint(checkpoint);
+    delete [] checkpoint->population;
+    delete [] checkpoint->fitnesses;
+    delete [] checkpoint->steps;
+    delete [] checkpoint->engineState;
+    delete checkpoint;
+}
+
+GAState *readCheckpoint(const char *fileName, Engine engine)
+{
+    FILE *file = fopen(fileName, "rb");
+    if(file == NULL){
+        cerr << "Error while opening the file " << fileName << "!!!" << endl;
+        return NULL;
+    }
+
+    CheckpointHeader header;
+    if(fread(&header, sizeof(CheckpointHeader), 1, file) != 1
+       || header.magic != CHECKPOINT_MAGIC
+       || header.version != CHECKPOINT_VERSION
+       || header.individualLen != genomeLen
+       || header.populationSize < 2
+       || header.cmaBytes < 0 || header.psoBytes < 0){
+        cerr << "File " << fileName << " is not a compatible checkpoint!!!" << endl;
+        fclose(file);
+        return NULL;
+    }
+    if(header.engine != engine){
+        cerr << "Checkpoint " << fileName << " was written by another engine!!!" << endl;
+        fclose(file);
+        return NULL;
+    }
+
+    int size = header.populationSize;
+    GAState *state = createGAState(size);
+    char *engineState = new char[header.cmaBytes + header.psoBytes];
+    bool ok = fread(state->population, sizeof(float), size*genomeLen, file)
+              == (size_t)size*genomeLen
+        && fread(state->fitnesses, sizeof(float), size, file) == (size_t)size
+        && (!header.stepsStored
+            || fread(state->steps, sizeof(float), size*genomeLen, file)
+               == (size_t)size*genomeLen)
+        && fread(engineState, 1, header.cmaBytes + header.psoBytes, file)
+           == (size_t)(header.cmaBytes + header.psoBytes);
+    fclose(file);
+
+    if(ok && header.cmaBytes > 0)
+        ok = (state->cma = loadCMAState(engineState, header.cmaBytes)) != NULL;
+    if(ok && header.psoBytes > 0)
+        ok = (state->pso = loadPSOState(engineState + header.cmaBytes, header.psoBytes)) != NULL;
+    delete [] engineState;
+
+    if(!ok){
+        cerr << "Checkpoint " << fileName << " is truncated!!!" << endl;
+        freeGAState(state);
+        return NULL;
+    }
+
+    state->generationNumber = header.generationNumber;
+    state->noChangeIter = header.noChangeIter;
+    state->bestFitness = header.bestFitness;
+    state->previousBestFitness = header.previousBestFitness;
+    state->evaluations = header.evaluations;
+    state->duplicates = header.duplicates;
+    for(int p=0; p<PHASE_COUNT; p++)
+        state->phaseTimes[p] = header.phaseTimes[p];
+    state->restarts = header.restarts;
+    state->mutationScale = header.mutationScale;
+    state->deMeanF = header.deMeanF;
+    state->deMeanCR = header.deMeanCR;
+    if(header.rngState != 0)
+        globalRng.state = header.rngState;
+
+    cout << "Restarting from checkpoint - generation " << state->generationNumber << endl;
+
+    return state;
+}
@@ -0,0 +1,52 @@
+/**
+    Binary checkpoint of the GA state, shared by CPU and MPI versions
+
+    File starts with the header, population follows as populationSize
+    individuals of individualLen floats each, then fitnesses of individuals
+    as populationSize floats. Population is sorted, fittest individual first.
+    Optional sections follow in this order: mutation steps laid out like the
+    population, cmaBytes of CMA-ES state and psoBytes of swarm state.
+    Checkpoint continues only a run of the engine that wrote it.
+*/
+
+#define CHECKPOINT_MAGIC 0x4b434147     // "GACK"
+#define CHECKPOINT_VERSION 3
+
+// Value of ENGINE_GA (cpu_version.h), the only engine of the MPI version
+#define CHECKPOINT_ENGINE_GA 0
+
+// Phase times stored, at least PHASE_COUNT (cpu_version.h)
+#define CHECKPOINT_PHASES 8
+
+struct CheckpointHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    int engine;                     // Engine that wrote the checkpoint
+    int populationSize;
+    int individualLen;
+    int generationNumber;
+    int noChangeIter;
+    float bestFitness;
+    float previousBestFitness;
+    unsigned long long rngState;    // 0 if state of generator is not stored
+    long long evaluations;
+    long long duplicates;
+    double phaseTimes[CHECKPOINT_PHASES];   // seconds spent in phases
+    int restarts;
+    float mutationScale;
+    float deMeanF;
+    float deMeanCR;
+    int stepsStored;                // mutation steps follow fitnesses
+    int cmaBytes;                   // 0 if CMA-ES state is not stored
+    int psoBytes;                   // 0 if swarm state is not stored
+};
+
+// Offset of population of individual @first in checkpoint file
+#define CHECKPOINT_POPULATION_OFFSET(first, individualLen) \
+    (sizeof(CheckpointHeader) + (long long)(first)*(individualLen)*sizeof(float))
+
+// Offset of fitness of individual @first in checkpoint file
+#define CHECKPOINT_FITNESS_OFFSET(first, populationSize, individualLen) \
+    (CHECKPOINT_POPULATION_OFFSET(populationSize, individualLen) \
+     + (long long)(first)*sizeof(float))
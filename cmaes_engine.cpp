@@ -0,0 +1,372 @@
+/**
+
+CMA-ES engine for low-dimensional coefficient fitting.
+
+Candidates are sampled from normal distribution N(m, sigma^2 C). The mean
+moves to the weighted mean of the better half of candidates, covariance C
+learns the directions of successful steps (rank-one update from evolution
+path pc and rank-mu update from the steps themselves) and step size sigma
+is controlled by the length of conjugate evolution path ps. Parameters
+follow N. Hansen, The CMA Evolution Strategy: A Tutorial.
+
+Genome has only a few coefficients, so eigen decomposition of C
+is recomputed by Jacobi rotations every generation. Candidates are sampled
+in one parallel batch, each with its own generator seeded from globalRng,
+and evaluated by the same fitness kernels as the GA. The best individual
+found so far is kept first in population, current candidates follow it.
+
+*/
+
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <omp.h>
+
+#include "config.h"
+#include "cpu_version.h"
+
+using namespace std;
+
+/**
+    Distribution and adaptation state, carried between calls
+*/
+struct CMAState
+{
+    int lambda;             // candidates per generation
+    int mu;                 // candidates the mean is recombined from
+    double weights[1024];   // recombination weights, mu <= lambda/2
+    double mueff;           // variance effective selection mass
+    double cc, cs, c1, cmu, damps, chiN;
+
+    //arrays are sized for the largest genome
+    double mean[MAX_GENOME_LEN];
+    double sigma;
+    double C[MAX_GENOME_LEN*MAX_GENOME_LEN];    // covariance matrix
+    double B[MAX_GENOME_LEN*MAX_GENOME_LEN];    // eigenvectors of C in columns
+    double D[MAX_GENOME_LEN];   // square roots of eigenvalues of C
+    double pc[MAX_GENOME_LEN];  // evolution path of covariance
+    double ps[MAX_GENOME_LEN];  // conjugate evolution path of sigma
+    int generation;
+};
+
+// Maximum number of candidates, limited by size of weights
+#define CMA_MAX_LAMBDA 2048
+
+/**
+    Eigen decomposition of symmetric matrix @A by cyclic Jacobi rotations,
+    A = V diag(eigenvalues) V^T, @A is destroyed
+*/
+static void jacobiEigen(double *A, double *eigenvalues, double *V)
+{
+    const int n = genomeLen;
+    for(int i=0; i<n; i++)
+        for(int j=0; j<n; j++)
+            V[i*n + j] = i == j;
+
+    for(int sweep=0; sweep<50; sweep++){
+        double offDiagonal = 0;
+        for(int p=0; p<n; p++)
+            for(int q=p+1; q<n; q++)
+                offDiagonal += A[p*n + q]*A[p*n + q];
+        if(offDiagonal < 1e-30)
+            break;
+
+        for(int p=0; p<n; p++){
+            for(int q=p+1; q<n; q++){
+                if(fabs(A[p*n + q]) < 1e-300)
+                    continue;
+
+                //rotation annihilating A_pq
+                double theta = (A[q*n + q] - A[p*n + p])/(2*A[p*n + q]);
+                double t = (theta >= 0 ? 1 : -1)/(fabs(theta) + sqrt(theta*theta + 1));
+                double c = 1/sqrt(t*t + 1);
+                double s = t*c;
+
+                for(int k=0; k<n; k++){
+                    double akp = A[k*n + p], akq = A[k*n + q];
+                    A[k*n + p] = c*akp - s*akq;
+                    A[k*n + q] = s*akp + c*akq;
+                }
+                for(int k=0; k<n; k++){
+                    double apk = A[p*n + k], aqk = A[q*n + k];
+                    A[p*n + k] = c*apk - s*aqk;
+                    A[q*n + k] = s*apk + c*aqk;
+                }
+                for(int k=0; k<n; k++){
+                    double vkp = V[k*n + p], vkq = V[k*n + q];
+                    V[k*n + p] = c*vkp - s*vkq;
+                    V[k*n + q] = s*vkp + c*vkq;
+                }
+            }
+        }
+    }
+
+    for(int i=0; i<n; i++)
+        eigenvalues[i] = A[i*n + i];
+}
+
+// Recomputes B and D from covariance matrix
+static void decompose(CMAState *cma)
+{
+    const int n = genomeLen;
+    //enforce symmetry lost by rounding
+    double A[MAX_GENOME_LEN*MAX_GENOME_LEN];
+    for(int i=0; i<n; i++)
+        for(int j=0; j<n; j++)
+            A[i*n + j] = 0.5*(cma->C[i*n + j] + cma->C[j*n + i]);
+
+    double eigenvalues[MAX_GENOME_LEN];
+    jacobiEigen(A, eigenvalues, cma->B);
+    for(int i=0; i<n; i++)
+        cma->D[i] = sqrt(max(eigenvalues[i], 1e-30));
+}
+
+/**
+    Starts distribution around the elite (or population mean if population
+    has not been evaluated yet) with spread of the population. Number of
+    candidates grows by ipop factor with every restart like population.
+*/
+static CMAState *createCMAState(const GAState *state, const Options *options)
+{
+    const int n = genomeLen;
+    CMAState *cma = new CMAState;
+
+    int lambda = options->cmaLambda;
+    if(lambda <= 0)
+        lambda = 4 + (int)(3*log((double)n));
+    lambda = (int)(lambda*pow(options->ipopFactor, state->restarts));
+    cma->lambda = min(min(lambda, state->size - 1), CMA_MAX_LAMBDA);
+    cma->mu = cma->lambda/2;
+
+    double sum = 0, sum2 = 0;
+    for(int i=0; i<cma->mu; i++){
+        cma->weights[i] = log(cma->mu + 0.5) - log(i + 1.0);
+        sum += cma->weights[i];
+    }
+    for(int i=0; i<cma->mu; i++){
+        cma->weights[i] /= sum;
+        sum2 += cma->weights[i]*cma->weights[i];
+    }
+    double mueff = 1/sum2;
+    cma->mueff = mueff;
+
+    cma->cc = (4 + mueff/n)/(n + 4 + 2*mueff/n);
+    cma->cs = (mueff + 2)/(n + mueff + 5);
+    cma->c1 = 2/((n + 1.3)*(n + 1.3) + mueff);
+    cma->cmu = min(1 - cma->c1, 2*(mueff - 2 + 1/mueff)/((n + 2)*(n + 2) + mueff));
+    cma->damps = 1 + 2*max(0.0, sqrt((mueff - 1)/(n + 1)) - 1) + cma->cs;
+    cma->chiN = sqrt((double)n)*(1 - 1.0/(4*n) + 1.0/(21*n*n));
+
+    //spread of population gives the initial step size
+    double mean[MAX_GENOME_LEN] = {0}, var = 0;
+    for(int i=0; i<state->size; i++)
+        for(int j=0; j<n; j++)
+            mean[j] += state->population[i*n + j]/state->size;
+    for(int i=0; i<state->size; i++)
+        for(int j=0; j<n; j++){
+            double d = state->population[i*n + j] - mean[j];
+            var += d*d/((double)state->size*n);
+        }
+
+    bool evaluated = state->bestFitness < INFINITY;
+    for(int j=0; j<n; j++){
+        cma->mean[j] = evaluated ? state->population[j] : mean[j];
+        cma->pc[j] = 0;
+        cma->ps[j] = 0;
+    }
+    cma->sigma = max(sqrt(var), (double)min_mutation_step);
+
+    for(int i=0; i<n*n; i++)
+        cma->C[i] = i % (n + 1) == 0;
+    decompose(cma);
+    cma->generation = 0;
+
+    return cma;
+}
+
+void freeCMAState(CMAState *cma)
+{
+    delete cma;
+}
+
+//state has only fixed size arrays, it is stored as it is
+int cmaStateBytes(const CMAState *cma)
+{
+    return sizeof(*cma);
+}
+
+void saveCMAState(const CMAState *cma, char *buffer)
+{
+    memcpy(buffer, cma, sizeof(CMAState));
+}
+
+CMAState *loadCMAState(const char *buffer, int bytes)
+{
+    if(bytes != (int)sizeof(CMAState))
+        return NULL;
+    CMAState *cma = new CMAState;
+    memcpy(cma, buffer, sizeof(CMAState));
+    return cma;
+}
+
+int runCMAES(GAState *state, const Dataset *data, int generations,
+             const Options *options)
+{
+    const int n = genomeLen;
+    float target = fitnessTarget(data);
+    int done = 0;
+
+    if(state->size < 3)
+        return 0;
+    if(state->cma == NULL)
+        state->cma = createCMAState(state, options);
+    CMAState *cma = state->cma;
+
+    int lambda = cma->lambda;
+    float *candidates = state->newPopulation;
+    float *fitnesses = new float[lambda];
+    double *steps = new double[lambda*n];     // y = B D z of every candidate
+    pair<float,int> *order = new pair<float,int>[lambda];
+
+    while ( (done < generations)
+            && (state->bestFitness > target)
+            && (state->noChangeIter < maxConstIter)
+            && !budgetExhausted(state, options) )
+    {
+        state->generationNumber++;
+        done++;
+        double t = omp_get_wtime();
+
+        unsigned long long base = ((unsigned long long)rngNext(&globalRng) << 32)
+                                  | rngNext(&globalRng);
+
+        /** sample all candidates in one batch */
+        #pragma omp parallel for schedule(static)
+        for(int k=0; k<lambda; k++)
+        {
+            Rng rng;
+            seedRng(&rng, base + k);
+
+            float z[MAX_GENOME_LEN];
+            rngNormals(&rng, z, n);
+
+            double *y = &steps[k*n];
+            for(int i=0; i<n; i++){
+                y[i] = 0;
+                for(int j=0; j<n; j++)
+                    y[i] += cma->B[i*n + j]*cma->D[j]*z[j];
+                candidates[k*n + i] = cma->mean[i] + cma->sigma*y[i];
+            }
+        }
+        t = lapPhase(state, PHASE_MUTATION, t);
+
+        /** evaluate candidates */
+        if(evaluateUntil(data, candidates, lambda, fitnesses, options->deadline) == NULL){
+            //generation is abandoned, distribution is untouched
+            state->generationNumber--;
+            done--;
+            state->interrupted = !datasetFailed(data);
+            lapPhase(state, PHASE_EVALUATION, t);
+            break;
+        }
+        state->evaluations += lambda;
+        t = lapPhase(state, PHASE_EVALUATION, t);
+
+        /** rank candidates */
+        for(int k=0; k<lambda; k++)
+            order[k] = make_pair(fitnesses[k], k);
+        sort(order, order + lambda);
+
+        //best so far stays first, current candidates follow in order
+        if(order[0].first < state->fitnesses[0]){
+            for(int j=0; j<n; j++)
+                state->population[j] = candidates[order[0].second*n + j];
+            state->fitnesses[0] = order[0].first;
+        }
+        for(int k=0; k<lambda; k++){
+            for(int j=0; j<n; j++)
+                state->population[(k+1)*n + j] = candidates[order[k].second*n + j];
+            state->fitnesses[k+1] = order[k].first;
+        }
+        state->bestFitness = state->fitnesses[0];
+        trackConvergence(state, data);
+
+        /** update of mean, evolution paths, covariance and step size */
+        double yw[MAX_GENOME_LEN] = {0};
+        for(int i=0; i<cma->mu; i++)
+            for(int j=0; j<n; j++)
+                yw[j] += cma->weights[i]*steps[order[i].second*n + j];
+        for(int j=0; j<n; j++)
+            cma->mean[j] += cma->sigma*yw[j];
+
+        //C^(-1/2) yw = B D^-1 B^T yw
+        double btyw[MAX_GENOME_LEN], invSqrtYw[MAX_GENOME_LEN];
+        for(int i=0; i<n; i++){
+            btyw[i] = 0;
+            for(int j=0; j<n; j++)
+                btyw[i] += cma->B[j*n + i]*yw[j];
+            btyw[i] /= cma->D[i];
+        }
+        for(int i=0; i<n; i++){
+            invSqrtYw[i] = 0;
+            for(int j=0; j<n; j++)
+                invSqrtYw[i] += cma->B[i*n + j]*btyw[j];
+        }
+
+        double csFactor = sqrt(cma->cs*(2 - cma->cs)*cma->mueff);
+        double psNorm = 0;
+        for(int j=0; j<n; j++){
+            cma->ps[j] = (1 - cma->cs)*cma->ps[j] + csFactor*invSqrtYw[j];
+            psNorm += cma->ps[j]*cma->ps[j];
+        }
+        psNorm = sqrt(psNorm);
+
+        cma->generation++;
+        bool hsig = psNorm/sqrt(1 - pow(1 - cma->cs, 2.0*cma->generation))/cma->chiN
+                    < 1.4 + 2.0/(n + 1);
+
+        double ccFactor = sqrt(cma->cc*(2 - cma->cc)*cma->mueff);
+        for(int j=0; j<n; j++)
+            cma->pc[j] = (1 - cma->cc)*cma->pc[j] + (hsig ? ccFactor*yw[j] : 0);
+
+        for(int i=0; i<n; i++){
+            for(int j=0; j<n; j++){
+                double rankMu = 0;
+                for(int k=0; k<cma->mu; k++){
+                    const double *y = &steps[order[k].second*n];
+                    rankMu += cma->weights[k]*y[i]*y[j];
+                }
+                double rankOne = cma->pc[i]*cma->pc[j]
+                    + (hsig ? 0 : cma->cc*(2 - cma->cc)*cma->C[i*n + j]);
+                cma->C[i*n + j] = (1 - cma->c1 - cma->cmu)*cma->C[i*n + j]
+                    + cma->c1*rankOne + cma->cmu*rankMu;
+            }
+        }
+
+        cma->sigma *= exp((cma->cs/cma->damps)*(psNorm/cma->chiN - 1));
+        cma->sigma = min(cma->sigma, 1e10);
+        decompose(cma);
+        t = lapPhase(state, PHASE_SELECTION, t);
+
+        //elite refined by Lamarck step or local search becomes the new mean
+        float unrefined = state->fitnesses[0];
+        refinePopulation(state, data, options);
+        if(state->fitnesses[0] < unrefined)
+            for(int j=0; j<n; j++)
+                cma->mean[j] = state->population[j];
+        lapPhase(state, PHASE_REFINEMENT, t);
+
+        //log message
+        #if defined(DEBUG)
+        cout << "#" << state->generationNumber<< " Fitness: " << state->bestFitness << \
+        " sigma: " << cma->sigma << endl;
+        #endif
+    }
+
+    delete [] fitnesses;
+    delete [] steps;
+    delete [] order;
+
+    return done;
+}
@@ -1,15 +1,60 @@
 #define POPULATION_SIZE (4096*16) /* must be multiple of 64 == BLOCK */
 #define INDIVIDUAL_LEN 4
+#define MAX_GENOME_LEN 32  /* coefficients of --model or --dims/--degree */
 #define N_POINTS 100
 
 #define maxGenerationNumber 1500
 #define maxConstIter 150
-#define targetErr (N_POINTS*0.005)
+#define targetErrPerPoint 0.005
+#define targetErr (N_POINTS*targetErrPerPoint)
 #define mu_individuals 0.5
 #define sigma_individuals 0.66
 #define mu_genes 0.56
 #define sigma_genes 0.75
 
+// Mutation step: fixed one, initial and bounds of adapted ones
+#define mutation_step 0.01
+#define initial_mutation_step 1.0
+#define min_mutation_step 1e-6
+#define max_mutation_step 10.0
+
+// Crossover: extension of parent interval of BLX-alpha and distribution
+// index of SBX, larger index creates children closer to parents
+#define blx_alpha 0.5f
+#define sbx_eta 2.0f
+
+// Fitness evaluations of every configuration in the first rung of portfolio
+#define portfolio_evaluations (16LL*POPULATION_SIZE)
+
+// Stddev of noise added to population restarted after stagnation
+#define restart_perturbation 1.0
+
+// Differential evolution: scale factor and crossover rate, initial ones
+// when they are adapted
+#define de_F 0.5
+#define de_CR 0.9
+
+// Particle swarm: inertia, attraction to personal and neighbourhood best
+// (constriction coefficients) and maximum velocity per gene
+#define pso_inertia 0.7298f
+#define pso_cognitive 1.49618f
+#define pso_social 1.49618f
+#define pso_max_velocity 10.0f
+
+// Warm start from known solutions: stddev of noise added to seeds
+// and fraction of population left random for diversity. Seeds are fitter
+// than random individuals and take over selection, so most of population
+// stays random and copies are spread widely, a poor seed must not trap
+// the run in its basin
+#define seed_perturbation 1.0
+#define seed_random_fraction 0.9
+
+// Stddev of noise of variants that replace duplicate parents
+#define dedup_perturbation 0.1
+
+// Residual where Huber loss turns linear and scale of Cauchy loss
+#define loss_scale 1.0
+
 // Emulate multi-process MPI on a single GPU, e.g. a laptop.
 // Uncomment if-clause to disable.
 #if 0
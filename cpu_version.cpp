@@ -24,26 +24,23 @@ Outputs:
 #include <iostream>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <cmath>
 #include <time.h>
 #include <algorithm>
+#include <omp.h>
 
 #include "config.h"
+#include "cpu_version.h"
+#include "expression.h"
+#include "surface.h"
+#include "loss.h"
+#include "precision.h"
 
 using namespace std;
 
-// Reads input file with noisy points. Points will be approximated by 
-// polynomial function using GA.
-float *readData(const char *name, const int POINTS_CNT);
-
-// Generages random no. with normal distribution
-float nrand(float mu, float sigma);
-
-// Box–Muller transform
-float stdrand();
-
-// Returns random number from interval <0.0, 1.0>
-float frand();
+// Number of points in one chunk of streamed binary input
+#define CHUNK_POINTS (1 << 20)
 
 /**
     An individual fitness function is the difference between measured f(x) and
@@ -51,36 +48,171 @@ float frand();
     evaluated on input data N.
 
     Smaller value means bigger fitness
+
+    Errors are accumulated chunk by chunk, the loop over points is outermost,
+    so the same kernel serves points held in memory and streamed points.
+    Deadline is checked roughly every 64K evaluated points, so even a chunk
+    of millions of points does not delay the end of the run.
+
+    Kernel is instantiated for every loss policy (loss.h) and precision
+    policy (precision.h).
 */
-float *fitness(float *individuals, float *points, float *current_fitnesses)
+
+// Loss of polynomial with coefficients @c at point @pt, Horner scheme
+template <class Loss, class Precision>
+static inline typename Precision::Value polynomialLoss(const Loss &loss,
+        const typename Precision::Value *c, const float *x, const float *y,
+        const float *w, int pt)
 {
+    typedef typename Precision::Value Value;
+    Value xv = x[pt];
+    Value f_approx = c[INDIVIDUAL_LEN - 1];
+    for(int order=INDIVIDUAL_LEN-2; order >= 0; order--)
+        f_approx = f_approx*xv + c[order];
+
+    Value diff = f_approx - y[pt];
+    return Loss::weighted ? w[pt]*loss(diff) : loss(diff);
+}
+
+template <class Loss, class Precision>
+static bool polynomialChunk(const Loss &loss, const float *individuals, int size,
+                            const float *x, const float *y, const float *w, int count,
+                            float *fitnesses, double deadline)
+{
+    typedef typename Precision::Value Value;
+    typedef typename Precision::Sum Sum;
+    int checkEvery = max(1, 65536/max(count, 1));
+    bool expired = false;
 
     //for every individual in population
-	for(int i=0; i < POPULATION_SIZE; i++)
-	{
-        float sumError = 0;
-
-        //for every given data point
-		for(int pt=0; pt<N_POINTS; pt++)
-		{
-			float f_approx = 0.;
-			
-            //for every polynomial parameter: Ci * x^(order)
-			for (int order=0; order < INDIVIDUAL_LEN; order++)
-			{
-				f_approx += individuals[i*INDIVIDUAL_LEN + order] * pow(points[pt], order);
-			}
-
-			sumError += pow(f_approx - points[N_POINTS+pt], 2);
-		}
-		
-        //The lower value of fitness is, the better individual fits the model
-		current_fitnesses[i] = sumError;
-	}
+    #pragma omp parallel for schedule(static)
+    for(int i=0; i < size; i++)
+    {
+        bool skip;
+        if(deadline > 0 && i % checkEvery == 0 && omp_get_wtime() >= deadline){
+            #pragma omp atomic write
+            expired = true;
+        }
+        #pragma omp atomic read
+        skip = expired;
+        if(skip)
+            continue;
+
+        Value c[INDIVIDUAL_LEN];
+        for(int order=0; order < INDIVIDUAL_LEN; order++)
+            c[order] = individuals[i*INDIVIDUAL_LEN + order];
+
+        if(!Precision::compensated){
+            Sum sumError = 0;
+
+            //for every given data point
+            #pragma omp simd reduction(+:sumError)
+            for(int pt=0; pt<count; pt++)
+                sumError += polynomialLoss<Loss, Precision>(loss, c, x, y, w, pt);
+
+            fitnesses[i] += sumError;
+        }else{
+            //every lane keeps its own compensated sum of every KAHAN_LANES-th point
+            float sum[KAHAN_LANES] = {0}, comp[KAHAN_LANES] = {0};
+            int body = count - count % KAHAN_LANES;
+            for(int first=0; first<body; first+=KAHAN_LANES){
+                #pragma omp simd
+                for(int lane=0; lane<KAHAN_LANES; lane++)
+                    kahanAdd(sum[lane], comp[lane],
+                             polynomialLoss<Loss, Precision>(loss, c, x, y, w, first + lane));
+            }
+            for(int pt=body; pt<count; pt++)
+                kahanAdd(sum[0], comp[0], polynomialLoss<Loss, Precision>(loss, c, x, y, w, pt));
+
+            float sumError = 0, correction = 0;
+            for(int lane=0; lane<KAHAN_LANES; lane++){
+                kahanAdd(sumError, correction, sum[lane]);
+                kahanAdd(sumError, correction, -comp[lane]);
+            }
+            fitnesses[i] += sumError;
+        }
+    }
 
+    return !expired;
+}
+
+// Instantiates polynomial kernel of @loss for the selected precision
+template <class Loss>
+static bool polynomialPrecision(const Loss &loss, const float *individuals, int size,
+                                const float *x, const float *y, const float *w, int count,
+                                float *fitnesses, double deadline)
+{
+    switch(precision){
+        case PRECISION_DOUBLE:
+            return polynomialChunk<Loss, DoublePrecision>(loss, individuals, size, x, y, w,
+                                                          count, fitnesses, deadline);
+        case PRECISION_MIXED:
+            return polynomialChunk<Loss, MixedPrecision>(loss, individuals, size, x, y, w,
+                                                         count, fitnesses, deadline);
+        case PRECISION_KAHAN:
+            return polynomialChunk<Loss, KahanPrecision>(loss, individuals, size, x, y, w,
+                                                         count, fitnesses, deadline);
+        default:
+            return polynomialChunk<Loss, FloatPrecision>(loss, individuals, size, x, y, w,
+                                                         count, fitnesses, deadline);
+    }
+}
+
+bool fitnessChunk(const float *individuals, int size,
+                  const float *x, const float *y, const float *w, int count,
+                  float *fitnesses, double deadline)
+{
+    if(userModel != NULL)
+        return expressionFitnessChunk(userModel, individuals, size, x, y, w, count,
+                                      fitnesses, deadline);
+
+    switch(lossFunction){
+        case LOSS_ABSOLUTE:
+            return polynomialPrecision(AbsoluteLoss(), individuals, size, x, y, w, count,
+                                       fitnesses, deadline);
+        case LOSS_HUBER:
+            return polynomialPrecision(HuberLoss(lossScale), individuals, size, x, y, w, count,
+                                       fitnesses, deadline);
+        case LOSS_CAUCHY:
+            return polynomialPrecision(CauchyLoss(lossScale), individuals, size, x, y, w, count,
+                                       fitnesses, deadline);
+        case LOSS_WEIGHTED:
+            return polynomialPrecision(WeightedSquaredLoss(), individuals, size, x, y, w, count,
+                                       fitnesses, deadline);
+        default:
+            return polynomialPrecision(SquaredLoss(), individuals, size, x, y, w, count,
+                                       fitnesses, deadline);
+    }
+}
+
+float *fitness(float *individuals, int size, float *points, long long nPoints,
+               const float *weights, float *current_fitnesses, double deadline)
+{
+    for(int i=0; i < size; i++)
+        current_fitnesses[i] = 0;
+
+    //points are in memory, x coordinates first, f(x) values follow
+    for(long long first=0; first < nPoints; first += CHUNK_POINTS)
+    {
+        //long evaluation is given up when time runs out
+        int count = min((long long)CHUNK_POINTS, nPoints - first);
+        const float *w = weights != NULL ? &weights[first] : NULL;
+        if(!fitnessChunk(individuals, size, &points[first], &points[nPoints + first],
+                         w, count, current_fitnesses, deadline))
+            return NULL;
+    }
+
+    //The lower value of fitness is, the better individual fits the model
 	return current_fitnesses;
 }
 
+// Returns true if file name has extension of binary point file
+static bool isBinaryInput(const char *name)
+{
+    size_t len = strlen(name);
+    return len > 4 && strcmp(name + len - 4, ".bin") == 0;
+}
+
 
 /**
     Individual is set of coeficients c1-c4. 
@@ -92,42 +224,135 @@ float *fitness(float *individuals, float *points, float *current_fitnesses)
       then
     child1  = [0 0 1 1]
     child2  = [1 1 0 0]
+
+    Every operator is a per-gene blend of the parents,
+    child1 = (1-a)*parent1 + a*parent2 and child2 = (1-b)*parent2 + b*parent1:
+    one-point and uniform crossover take a from {0, 1}, arithmetic one random
+    a == b per pair, SBX a == b from the polynomial spread distribution and
+    BLX-alpha independent a, b from [-alpha, 1+alpha]. Parents and blend
+    coefficients of a block of pairs are drawn first, then all genes of the
+    block are blended by one vectorized loop. First children of all pairs are
+    stored after the elite, second children after them, so the loop writes
+    contiguous memory. Blocks write disjoint ranges of children and are
+    created in parallel, every block with its own random stream, so the new
+    population does not depend on the number of threads.
 */
 
-void crossover(float *oldPopulation, float *newPopulation)
+// Pairs of children created by one vectorized loop
+#define CROSSOVER_BLOCK 64
+
+// Draws blend coefficients @a and @b of genes of one pair
+static void drawBlend(Rng *rng, Crossover op, float *a, float *b)
+{
+    switch(op){
+        case CROSSOVER_BLX:
+            for(int j=0; j<genomeLen; j++){
+                a[j] = -blx_alpha + (1 + 2*blx_alpha)*rngUniform(rng);
+                b[j] = -blx_alpha + (1 + 2*blx_alpha)*rngUniform(rng);
+            }
+            break;
+        case CROSSOVER_SBX:
+            for(int j=0; j<genomeLen; j++){
+                float u = rngUniform(rng);
+                float beta = u <= 0.5f ? powf(2*u, 1/(sbx_eta + 1))
+                                       : powf(1/(2*(1 - u)), 1/(sbx_eta + 1));
+                a[j] = b[j] = (1 - beta)/2;
+            }
+            break;
+        case CROSSOVER_ARITHMETIC: {
+            float lambda = rngUniform(rng);
+            for(int j=0; j<genomeLen; j++)
+                a[j] = b[j] = lambda;
+            break;
+        }
+        case CROSSOVER_UNIFORM:
+            for(int j=0; j<genomeLen; j++)
+                a[j] = b[j] = rngNext(rng) & 1;
+            break;
+        default: {
+            //select crosspoint, do not select beginning and end of individual as crosspoint
+            int crosspoint = genomeLen > 2 ? rngNext(rng) % (genomeLen - 2) + 1
+                                           : genomeLen - 1;
+            for(int j=0; j<genomeLen; j++)
+                a[j] = b[j] = j < crosspoint ? 0 : 1;
+        }
+    }
+}
+
+void crossover(float *oldPopulation, float *newPopulation, int size,
+               float *oldSteps, float *newSteps,
+               const float *fitnesses, float *parentFitnesses, Crossover op)
 {
     
     //copy fittest first half of population
-    for(int i = 0; i < POPULATION_SIZE/2*INDIVIDUAL_LEN; i++)
+    #pragma omp parallel for schedule(static)
+    for(int i = 0; i < size/2*genomeLen; i++)
     {
         newPopulation[i] = oldPopulation[i];    
+        newSteps[i] = oldSteps[i];
     }
+    for(int i = 0; i < size/2; i++)
+        parentFitnesses[i] = fitnesses[i];
 
     //create children from first half of the fittest population
-	for(int i = POPULATION_SIZE/2*INDIVIDUAL_LEN;
-            i < POPULATION_SIZE*INDIVIDUAL_LEN;
-            i += 2*INDIVIDUAL_LEN) 
-	{
-        //randomly select two fit parrents for mating from the fittest half of the population
-		int parent1_i = (random() % (POPULATION_SIZE/2)) * INDIVIDUAL_LEN;
-		int parent2_i = (random() % (POPULATION_SIZE/2)) * INDIVIDUAL_LEN;
-
-
-        //select crosspoint, do not select beginning and end of individual as crosspoint
-		int crosspoint = random() % (INDIVIDUAL_LEN - 2) + 1;
-        for(int j=0; j<INDIVIDUAL_LEN; j++){
-            if(j<crosspoint)
-            {
-                newPopulation[i+j] = oldPopulation[parent1_i*INDIVIDUAL_LEN + j];
-                newPopulation[i+j+INDIVIDUAL_LEN] = oldPopulation[parent2_i*INDIVIDUAL_LEN + j];  
-            } else
-            {
-                newPopulation[i+j] = oldPopulation[parent2_i*INDIVIDUAL_LEN + j];
-                newPopulation[i+j+INDIVIDUAL_LEN] = oldPopulation[parent1_i*INDIVIDUAL_LEN + j];
-            }
+    int parents = size/2;
+    int firstChildren = (size - parents + 1)/2;
+    int secondChildren = (size - parents)/2;
+
+    int nBlocks = (firstChildren + CROSSOVER_BLOCK - 1)/CROSSOVER_BLOCK;
+    unsigned long long base = ((unsigned long long)rngNext(&globalRng) << 32)
+                              | rngNext(&globalRng);
+
+    #pragma omp parallel for schedule(static)
+    for(int blockIndex = 0; blockIndex < nBlocks; blockIndex++)
+    {
+        Rng rng;
+        seedRng(&rng, base + blockIndex);
+        float p1[CROSSOVER_BLOCK*MAX_GENOME_LEN], p2[CROSSOVER_BLOCK*MAX_GENOME_LEN];
+        float s1[CROSSOVER_BLOCK*MAX_GENOME_LEN], s2[CROSSOVER_BLOCK*MAX_GENOME_LEN];
+        float a[CROSSOVER_BLOCK*MAX_GENOME_LEN], b[CROSSOVER_BLOCK*MAX_GENOME_LEN];
+
+        int block = blockIndex*CROSSOVER_BLOCK;
+        int count = min(CROSSOVER_BLOCK, firstChildren - block);
+        for(int k = 0; k < count; k++)
+        {
+            //randomly select two fit parrents for mating from the fittest half of the population
+            int parent1 = rngNext(&rng) % parents;
+            int parent2 = rngNext(&rng) % parents;
+            memcpy(&p1[k*genomeLen], &oldPopulation[parent1*genomeLen], genomeLen*sizeof(float));
+            memcpy(&p2[k*genomeLen], &oldPopulation[parent2*genomeLen], genomeLen*sizeof(float));
+            memcpy(&s1[k*genomeLen], &oldSteps[parent1*genomeLen], genomeLen*sizeof(float));
+            memcpy(&s2[k*genomeLen], &oldSteps[parent2*genomeLen], genomeLen*sizeof(float));
+            drawBlend(&rng, op, &a[k*genomeLen], &b[k*genomeLen]);
+
+            //both children are compared with the fitter parent
+            float parentFitness = min(fitnesses[parent1], fitnesses[parent2]);
+            parentFitnesses[parents + block + k] = parentFitness;
+            if(block + k < secondChildren)
+                parentFitnesses[parents + firstChildren + block + k] = parentFitness;
         }
 
-	}
+        //mutation steps are blended like their genes, but never extrapolated
+        int n = count*genomeLen;
+        float *child1 = &newPopulation[(parents + block)*genomeLen];
+        float *step1 = &newSteps[(parents + block)*genomeLen];
+        #pragma omp simd
+        for(int g = 0; g < n; g++){
+            float w = min(max(a[g], 0.0f), 1.0f);
+            child1[g] = (1 - a[g])*p1[g] + a[g]*p2[g];
+            step1[g] = (1 - w)*s1[g] + w*s2[g];
+        }
+
+        n = max(0, min(count, secondChildren - block))*genomeLen;
+        float *child2 = &newPopulation[(parents + firstChildren + block)*genomeLen];
+        float *step2 = &newSteps[(parents + firstChildren + block)*genomeLen];
+        #pragma omp simd
+        for(int g = 0; g < n; g++){
+            float w = min(max(b[g], 0.0f), 1.0f);
+            child2[g] = (1 - b[g])*p2[g] + b[g]*p1[g];
+            step2[g] = (1 - w)*s2[g] + w*s1[g];
+        }
+    }
 }
 
 /**
@@ -142,21 +367,87 @@ void crossover(float *oldPopulation, float *newPopulation)
        2nd: num_of_bit_to_mutate = 0
             inverse individuals[0]   ->   [0 1 0 1]
     return mutated individual         [0 1 0 1]
+
+    Step of the noise is either fixed, global @scale controlled by 1/5th
+    success rule, or self-adapted: every gene carries its own step, which is
+    multiplied by log-normal noise before the gene is mutated, so steps
+    producing fit individuals survive selection together with them.
+    @mutated marks individuals with at least one mutated gene.
+
+    With @rate > 0 every gene is mutated with probability @rate. Genes of
+    the population are one flat array and the distance to the next mutated
+    gene is drawn from the geometric distribution, so random numbers are
+    drawn for mutated genes only. Step of a mutated gene is self-adapted
+    together with it, steps of unchanged genes stay.
 */
-float *mutation(float *individuals)
+
+// Mutates genes of individuals 1 .. @size-1 chosen by geometric skips
+static void sparseMutation(float *individuals, float *steps, int size, Mutation mode,
+                           float scale, float rate, unsigned char *mutated)
 {
+    const float tau = 1/sqrt(2.0*genomeLen) + 1/sqrt(2*sqrt((double)genomeLen));
+    const double logKeep = log1p(-min(rate, 1.0f));
+    const long long end = (long long)size*genomeLen;
+
+    memset(&mutated[1], 0, size - 1);
+    for(long long idx = genomeLen; ; idx++)
+    {
+        //number of unchanged genes before the next mutated one
+        double skip = rate < 1 ? floor(log(1 - frand())/logKeep) : 0;
+        if(skip >= end - idx)
+            break;
+        idx += (long long)skip;
+
+        mutated[idx/genomeLen] = 1;
+        if(mode == MUTATION_SELF_ADAPTIVE){
+            float step = steps[idx]*exp(tau*stdrand());
+            steps[idx] = min(max(step, (float)min_mutation_step), (float)max_mutation_step);
+            individuals[idx] += steps[idx]*stdrand();
+        }
+        else
+            individuals[idx] += scale*(2*frand()-1);
+    }
+}
+
+float *mutation(float *individuals, float *steps, int size, const Options *options,
+                float scale, unsigned char *mutated)
+{
+    Mutation mode = options->mutation;
+    if(options->mutationRate > 0){
+        sparseMutation(individuals, steps, size, mode, scale, options->mutationRate, mutated);
+        return individuals;
+    }
+
+    //learning rates of log-normal self-adaptation
+    const float tauCommon = 1/sqrt(2.0*genomeLen);
+    const float tauGene = 1/sqrt(2*sqrt((double)genomeLen));
+
 	//first individual is left without changes to keep the best individual  		
-    for(int i=1; i<POPULATION_SIZE; i++)
+    for(int i=1; i<size; i++)
     {
         //probability of mutating individual
-        int mutNumber = nrand(mu_individuals, sigma_individuals);
+        int mutNumber = nrand(options->muIndividuals, options->sigmaIndividuals);
+        float common = mode == MUTATION_SELF_ADAPTIVE ? tauCommon*stdrand() : 0;
+        mutated[i] = 0;
 
-        for(int j=0; j<INDIVIDUAL_LEN; j++)
+        for(int j=0; j<genomeLen; j++)
         {
-            int idx = i*INDIVIDUAL_LEN + j;
+            int idx = i*genomeLen + j;
+
+            //step evolves first, so that it is judged by the move it makes
+            if(mode == MUTATION_SELF_ADAPTIVE){
+                float step = steps[idx]*exp(common + tauGene*stdrand());
+                steps[idx] = min(max(step, (float)min_mutation_step), (float)max_mutation_step);
+            }
+
             //probability of mutating gene 
-            if(nrand(mu_genes, sigma_genes) < mutNumber)
-                individuals[idx] += 0.01*(2*frand()-1);        
+            if(nrand(options->muGenes, options->sigmaGenes) < mutNumber){
+                mutated[i] = 1;
+                if(mode == MUTATION_SELF_ADAPTIVE)
+                    individuals[idx] += steps[idx]*stdrand();
+                else
+                    individuals[idx] += scale*(2*frand()-1);
+            }
         }
     }
 	
@@ -176,26 +467,31 @@ bool myCmpPair(pair<float,int> p1, pair<float,int> p2)
 	individuals with small (good) fitness value to the beginning 
 	individuals with large (bad) fitness value to the end;
     return sorted population of individuals;
+    fitnesses are sorted in place to match the sorted population,
+    mutation steps are reordered together with individuals
 */
-float *selection(float *population, float *fitnesses, float *newPopulation)
+float *selection(float *population, float *fitnesses, float *newPopulation, int size,
+                 float *steps, float *newSteps)
 {
     //array of fitness-indexes pairs for sorting algorithm, AoS
-    pair<float,int> *pairs = new pair<float,int>[POPULATION_SIZE];
+    pair<float,int> *pairs = new pair<float,int>[size];
 
-    for (int i=0; i<POPULATION_SIZE; i++) 
+    for (int i=0; i<size; i++) 
     {
         //pair(fitness, index)
         pairs[i] = make_pair(fitnesses[i],i);
     }        
-    sort(pairs, pairs+POPULATION_SIZE, myCmpPair);
+    sort(pairs, pairs+size, myCmpPair);
 
     //reorder population so that fittest individuals are first
-    for (int i=0; i<POPULATION_SIZE; i++){
-        for (int j=0; j<INDIVIDUAL_LEN; j++)
+    for (int i=0; i<size; i++){
+        for (int j=0; j<genomeLen; j++)
         {
-            newPopulation[i*INDIVIDUAL_LEN + j]
-                = population[pairs[i].second*INDIVIDUAL_LEN + j];
+            newPopulation[i*genomeLen + j]
+                = population[pairs[i].second*genomeLen + j];
+            newSteps[i*genomeLen + j] = steps[pairs[i].second*genomeLen + j];
         }
+        fitnesses[i] = pairs[i].first;
     }
     
     delete [] pairs;
@@ -203,121 +499,1281 @@ float *selection(float *population, float *fitnesses, float *newPopulation)
     return newPopulation;
 }
 
-/*
-    Main body of the GA
+// Hash of grid cell of size @epsilon the genome falls into
+static unsigned long long cellHash(const float *genome, float epsilon)
+{
+    unsigned long long h = 0x9E3779B97F4A7C15ULL;
+    for(int j=0; j<genomeLen; j++){
+        long long cell = (long long)floor(genome[j]/epsilon);
+        h = (h ^ (unsigned long long)cell)*0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 31;
+    }
+    h = (h ^ (h >> 30))*0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27))*0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+/**
+    Replaces duplicates among parents (fitter half of sorted population)
+    by heavily mutated variants of the individual they duplicate
+
+    Genomes are equal if they are bitwise equal (@epsilon == 0) or fall into
+    the same cell of grid with spacing @epsilon. Hashes are sorted, so equal
+    genomes are adjacent and the fittest of them, which comes first, is kept.
+    Variants get unknown fitness, they are evaluated in the next generation.
+    Returns number of replaced individuals.
 */
-int main(int argc, char **argv)
+static int eliminateDuplicates(GAState *state, float epsilon)
 {
-    if(argc != 2){
-        cerr << "Usage: $./cpu inputFile" << endl;
-        return -1;
+    int n = state->size/2;
+    pair<unsigned long long,int> *keys = new pair<unsigned long long,int>[n];
+
+    #pragma omp parallel for schedule(static)
+    for(int i=0; i<n; i++){
+        const float *genome = &state->population[i*genomeLen];
+        keys[i] = make_pair(epsilon > 0 ? cellHash(genome, epsilon) : genomeHash(genome), i);
     }
+    sort(keys, keys + n);
 
-    //read input data
-    //points are the data to approximate by a polynomial
-    float *points = readData(argv[1], N_POINTS);
-    if(points == NULL)
-        return -1;
+    //duplicate and the individual it duplicates
+    int *duplicates = new int[n];
+    int *originals = new int[n];
+    int count = 0;
+    for(int k=1, first=0; k<n; k++){
+        if(keys[k].first != keys[first].first){
+            first = k;
+            continue;
+        }
+        duplicates[count] = keys[k].second;
+        originals[count] = keys[first].second;
+        count++;
+    }
+
+    unsigned long long base = ((unsigned long long)rngNext(&globalRng) << 32)
+                              | rngNext(&globalRng);
+
+    #pragma omp parallel for schedule(static)
+    for(int k=0; k<count; k++){
+        Rng rng;
+        seedRng(&rng, base + k);
+        float *individual = &state->population[duplicates[k]*genomeLen];
+        const float *original = &state->population[originals[k]*genomeLen];
+        for(int j=0; j<genomeLen; j++)
+            individual[j] = original[j] + dedup_perturbation*rngNormal(&rng);
+        state->fitnesses[duplicates[k]] = INFINITY;
+    }
+
+    delete [] keys;
+    delete [] duplicates;
+    delete [] originals;
+
+    return count;
+}
+
+/**
+    Evaluates fitness of individuals on the data set,
+    whichever form the data are held in
+*/
+static float *evaluateData(const Dataset *data, float *individuals, int size,
+                           float *fitnesses, double deadline)
+{
+    if(data->stats != NULL)
+        return statsFitness(data->stats, individuals, size, fitnesses);
+    if(data->surface != NULL)
+        return surfaceFitness(data->surface, individuals, size, data->weights,
+                              fitnesses, deadline);
+    if(data->stream != NULL)
+        return streamFitness(data->stream, individuals, size, fitnesses, deadline);
+    return fitness(individuals, size, data->points, data->nPoints, data->weights,
+                   fitnesses, deadline);
+}
+
+/**
+    Known genomes take fitness from the cache, only the rest is gathered
+    and evaluated on the data
+*/
+float *evaluateUntil(const Dataset *data, float *individuals, int size,
+                     float *fitnesses, double deadline)
+{
+    FitnessCache *cache = data->cache;
+    if(cache == NULL)
+        return evaluateData(data, individuals, size, fitnesses, deadline);
 
-    //arrays to hold old and new population    
-    float *population = new float[POPULATION_SIZE * INDIVIDUAL_LEN * sizeof(float)];
-    float *newPopulation = new float[POPULATION_SIZE * INDIVIDUAL_LEN * sizeof(float)];
+    unsigned long long *hashes = new unsigned long long[size];
+    unsigned char *known = new unsigned char[size];
+    int hits = 0;
+
+    #pragma omp parallel for schedule(static) reduction(+:hits)
+    for(int i=0; i<size; i++){
+        hashes[i] = genomeHash(&individuals[i*genomeLen]);
+        known[i] = cacheLookup(cache, hashes[i], &fitnesses[i]);
+        hits += known[i];
+    }
+    cache->lookups += size;
+    cache->hits += hits;
+
+    int nMissing = size - hits;
+    int *missing = new int[nMissing];
+    float *genomes = new float[nMissing*genomeLen];
+    float *missingFitnesses = new float[nMissing];
+    for(int i=0, k=0; i<size; i++){
+        if(known[i])
+            continue;
+        memcpy(&genomes[k*genomeLen], &individuals[i*genomeLen], genomeLen*sizeof(float));
+        missing[k++] = i;
+    }
+
+    //interrupted evaluation leaves cache untouched
+    bool complete = nMissing == 0
+        || evaluateData(data, genomes, nMissing, missingFitnesses, deadline) != NULL;
+    if(complete){
+        #pragma omp parallel for schedule(static)
+        for(int k=0; k<nMissing; k++){
+            fitnesses[missing[k]] = missingFitnesses[k];
+            cacheStore(cache, hashes[missing[k]], missingFitnesses[k]);
+        }
+    }
+
+    delete [] hashes;
+    delete [] known;
+    delete [] missing;
+    delete [] genomes;
+    delete [] missingFitnesses;
+
+    return complete ? fitnesses : NULL;
+}
+
+float *evaluate(const Dataset *data, float *individuals, int size, float *fitnesses)
+{
+    return evaluateUntil(data, individuals, size, fitnesses, 0);
+}
+
+bool datasetFailed(const Dataset *data)
+{
+    return data->stream != NULL && data->stream->failed;
+}
+
+// Returns (effective) number of points in the data set
+double datasetPoints(const Dataset *data)
+{
+    if(data->stats != NULL)
+        return data->stats->weight;
+    if(data->stream != NULL)
+        return data->stream->count;
+    return data->nPoints;
+}
+
+float fitnessTarget(const Dataset *data)
+{
+    return targetErrPerPoint*datasetPoints(data)/data->fitnessScale;
+}
+
+GAState *createGAState(int size)
+{
+    GAState *state = new GAState;
+    state->size = size;
+
+    //arrays to hold old and new population
+    state->population = new float[size * genomeLen];
+    state->newPopulation = new float[size * genomeLen];
 
     //arrays that keeps fitness of individuals withing current population
-    float *current_fitnesses = new float[POPULATION_SIZE];
+    state->fitnesses = new float[size];
+    for(int i=0; i<size; i++)
+        state->fitnesses[i] = INFINITY;
+
+    //self-adapted mutation steps start large to cross the search space
+    state->steps = new float[size * genomeLen];
+    state->newSteps = new float[size * genomeLen];
+    for(int i=0; i<size * genomeLen; i++)
+        state->steps[i] = initial_mutation_step;
+    state->mutationScale = initial_mutation_step;
+    state->deMeanF = de_F;
+    state->deMeanCR = de_CR;
+    state->cma = NULL;
+    state->pso = NULL;
+    state->mutated = new unsigned char[size];
+    state->parentFitnesses = new float[size];
+
+    state->generationNumber = 0;
+    state->noChangeIter = 0;
+    state->evaluations = 0;
+    state->duplicates = 0;
+    state->restarts = 0;
+    state->interrupted = false;
+    for(int p=0; p<PHASE_COUNT; p++)
+        state->phaseTimes[p] = 0;
+    state->bestFitness = INFINITY;
+    state->previousBestFitness = INFINITY;
+
+    return state;
+}
 
+void freeGAState(GAState *state)
+{
+    delete [] state->fitnesses;
+    delete [] state->population;
+    delete [] state->newPopulation;
+    delete [] state->steps;
+    delete [] state->newSteps;
+    delete [] state->mutated;
+    delete [] state->parentFitnesses;
+    if(state->cma != NULL)
+        freeCMAState(state->cma);
+    if(state->pso != NULL)
+        freePSOState(state->pso);
+    delete state;
+}
+
+void initPopulation(GAState *state)
+{
     //Initialize first population ( with zeros or some random values )
-	for(int i=0; i<POPULATION_SIZE * INDIVIDUAL_LEN; i++){
-        population[i] = ((float)rand()/RAND_MAX)*10 - 5; //<-5.0; 5.0>
+	for(int i=0; i<state->size * genomeLen; i++){
+        state->population[i] = frand()*10 - 5; //<-5.0; 5.0>
     }
+}
 
+void seedPopulation(GAState *state, const float *seeds, int nSeeds,
+                    float perturbation, float randomFraction)
+{
+    int size = state->size;
+    int nSeeded = size - (int)(randomFraction*size);
+    if(nSeeded < nSeeds)
+        nSeeded = min(nSeeds, size);
 
-    /**
-        Main GA loop
-    */
-    int t1 = clock(); //start timer
+    for(int i=0; i<size; i++){
+        float *individual = &state->population[i*genomeLen];
+        const float *seed = &seeds[(i % nSeeds)*genomeLen];
 
-    int generationNumber = 0;
-    int noChangeIter = 0;
+        for(int j=0; j<genomeLen; j++){
+            if(i < nSeeds)
+                individual[j] = seed[j];
+            else if(i < nSeeded)
+                individual[j] = seed[j] + nrand(0, perturbation);
+            else
+                individual[j] = frand()*10 - 5; //<-5.0; 5.0>
+        }
+    }
+}
 
-    float bestFitness = INFINITY;
-    float previousBestFitness = INFINITY;
+GAState *restartPopulation(GAState *state, const Options *options)
+{
+    int oldSize = state->size;
+    int size = oldSize;
+    if(options->ipopFactor > 1)
+        size = (int)(oldSize*options->ipopFactor + 1) / 2 * 2;
+
+    GAState *restarted = state;
+    if(size != oldSize){
+        restarted = createGAState(size);
+        for(int i=0; i<size*genomeLen; i++)
+            restarted->population[i] = state->population[i % (oldSize*genomeLen)];
+        restarted->fitnesses[0] = state->fitnesses[0];
+        restarted->generationNumber = state->generationNumber;
+        restarted->evaluations = state->evaluations;
+        restarted->duplicates = state->duplicates;
+        restarted->restarts = state->restarts;
+        for(int p=0; p<PHASE_COUNT; p++)
+            restarted->phaseTimes[p] = state->phaseTimes[p];
+        restarted->bestFitness = state->bestFitness;
+        freeGAState(state);
+    }
 
-	while ( (generationNumber < maxGenerationNumber)
-            && (bestFitness > targetErr)
-            && (noChangeIter < maxConstIter) )
+    //the elite is kept, so the best solution found so far is never lost
+    for(int i=1; i<size; i++){
+        float *individual = &restarted->population[i*genomeLen];
+        for(int j=0; j<genomeLen; j++){
+            if(options->stagnation == STAGNATION_REINIT)
+                individual[j] = frand()*10 - 5; //<-5.0; 5.0>
+            else
+                individual[j] += nrand(0, restart_perturbation);
+        }
+        restarted->fitnesses[i] = INFINITY;
+    }
+
+    //mutation steps shrunk during convergence are reset
+    for(int i=0; i<size*genomeLen; i++)
+        restarted->steps[i] = initial_mutation_step;
+    restarted->mutationScale = initial_mutation_step;
+    restarted->deMeanF = de_F;
+    restarted->deMeanCR = de_CR;
+
+    //distribution of CMA-ES starts again around the elite
+    if(restarted->cma != NULL){
+        freeCMAState(restarted->cma);
+        restarted->cma = NULL;
+    }
+    if(restarted->pso != NULL){
+        freePSOState(restarted->pso);
+        restarted->pso = NULL;
+    }
+
+    restarted->noChangeIter = 0;
+    restarted->previousBestFitness = INFINITY;
+    restarted->restarts++;
+
+    return restarted;
+}
+
+bool deadlinePassed(const Options *options)
+{
+    return options->deadline > 0 && omp_get_wtime() >= options->deadline;
+}
+
+bool budgetExhausted(const GAState *state, const Options *options)
+{
+    return (options->maxEvaluations > 0 && state->evaluations >= options->maxEvaluations)
+        || deadlinePassed(options);
+}
+
+double lapPhase(GAState *state, Phase phase, double start)
+{
+    double now = omp_get_wtime();
+    state->phaseTimes[phase] += now - start;
+    return now;
+}
+
+void trackConvergence(GAState *state, const Dataset *data)
+{
+    //check if the fitness is decreasing or if we are stuck at local minima,
+    //change is measured in original units of normalized points
+    if(fabs(state->bestFitness - state->previousBestFitness) < 0.01/data->fitnessScale)
+        state->noChangeIter++;
+    else
+        state->noChangeIter = 0;
+    state->previousBestFitness = state->bestFitness;
+}
+
+void refinePopulation(GAState *state, const Dataset *data, const Options *options)
+{
+    /** Lamarckian step, elite inherits least-squares refinement */
+    if(options->lamarckEvery > 0 && state->generationNumber % options->lamarckEvery == 0
+       && !deadlinePassed(options))
+        lamarckianRefinement(state, data);
+
+    /** local search finishes fine tuning of the fittest individuals */
+    if(options->localSearchTop > 0 && !deadlinePassed(options))
+        localSearch(state, data, options->localSearchTop, options->lmSteps,
+                    options->jacobian);
+}
+
+int runEngine(GAState *state, const Dataset *data, int generations,
+              const Options *options)
+{
+    switch(options->engine){
+        case ENGINE_DE:
+            return runDifferentialEvolution(state, data, generations, options);
+        case ENGINE_CMAES:
+            return runCMAES(state, data, generations, options);
+        case ENGINE_PSO:
+            return runParticleSwarm(state, data, generations, options);
+        case ENGINE_SMALL:
+            return runSmallEngine(state, data, generations, options);
+        default:
+            return runGenerations(state, data, generations, options);
+    }
+}
+
+/**
+    Main GA loop
+
+    Runs at most @generations generations on population in @state,
+    stops earlier when target error is reached, when the best fitness
+    has not changed for maxConstIter generations or when the budget is spent.
+
+    Deadline is checked between phases and inside long fitness evaluation.
+    Generation cut by the deadline is abandoned, the elite individual stays
+    first with its fitness, so the best solution so far is always at hand.
+*/
+int runGenerations(GAState *state, const Dataset *data, int generations,
+                   const Options *options)
+{
+    int size = state->size;
+    float target = fitnessTarget(data);
+    int done = 0;
+
+	while ( (done < generations)
+            && (state->bestFitness > target)
+            && (state->noChangeIter < maxConstIter)
+            && !budgetExhausted(state, options) )
 	{
-		generationNumber++;
-	
+		state->generationNumber++;
+        done++;
+        double t = omp_get_wtime();
+
         /** crossover first half of the population and create new population */
-		crossover(population, newPopulation);
-        float *tmp = population;//put new individuals into $population
-        population = newPopulation;
-        newPopulation = tmp;
+		crossover(state->population, state->newPopulation, size,
+                  state->steps, state->newSteps,
+                  state->fitnesses, state->parentFitnesses, options->crossover);
+        float *tmp = state->population;//put new individuals into $population
+        state->population = state->newPopulation;
+        state->newPopulation = tmp;
+        swap(state->steps, state->newSteps);
+        t = lapPhase(state, PHASE_CROSSOVER, t);
 
 		/** mutate population and childrens in the whole population*/
-		population = mutation(population);
-		
+        float scale = options->mutation == MUTATION_FIXED ? mutation_step : state->mutationScale;
+		mutation(state->population, state->steps, size, options, scale,
+                 state->mutated);
+        t = lapPhase(state, PHASE_MUTATION, t);
+
         /** evaluate fitness of individuals in population */
-		fitness(population, points, current_fitnesses);
-        bestFitness = current_fitnesses[0];
+        if(evaluateUntil(data, state->population, size, state->fitnesses,
+                         options->deadline) == NULL){
+            //generation is abandoned, the elite is unchanged by crossover and mutation
+            for(int i=1; i<size; i++)
+                state->fitnesses[i] = INFINITY;
+            state->fitnesses[0] = state->bestFitness;
+            state->generationNumber--;
+            done--;
+            state->interrupted = !datasetFailed(data);
+            lapPhase(state, PHASE_EVALUATION, t);
+            break;
+        }
+        state->evaluations += size;
+        state->bestFitness = state->fitnesses[0];
+        t = lapPhase(state, PHASE_EVALUATION, t);
 
-        //check if the fitness is decreasing or if we are stuck at local minima
-        if(fabs(bestFitness - previousBestFitness) < 0.01)
-            noChangeIter++;
-        else
-            noChangeIter = 0;
-        previousBestFitness = bestFitness;
+        /** 1/5th success rule, enlarge step if mutations succeed often */
+        if(options->mutation == MUTATION_ONE_FIFTH){
+            //mutation succeeds if the individual gets fitter than its parents
+            int successes = 0, trials = 0;
+            for(int i=1; i<size; i++){
+                if(!state->mutated[i] || state->parentFitnesses[i] == INFINITY)
+                    continue;
+                trials++;
+                successes += state->fitnesses[i] < state->parentFitnesses[i];
+            }
+            float rate = successes / (float)max(trials, 1);
+
+            float step = rate > 0.2 ? state->mutationScale/0.85 : state->mutationScale*0.85;
+            state->mutationScale = min(max(step, (float)min_mutation_step),
+                                       (float)max_mutation_step);
+        }
+
+        trackConvergence(state, data);
 
         /** select individuals for mating for next generation,
             i.e. sort population according to its fitness and keep
             fittest individuals first in population  */
-        tmp = population; //put sorted individuals into $population
-        population = selection(population, current_fitnesses, newPopulation);
-        newPopulation = tmp;
+        tmp = state->population; //put sorted individuals into $population
+        state->population = selection(state->population, state->fitnesses,
+                                       state->newPopulation, size,
+                                       state->steps, state->newSteps);
+        state->newPopulation = tmp;
+        swap(state->steps, state->newSteps);
+
+        /** parents equal to fitter parents are replaced by new variants */
+        if(options->dedupEpsilon >= 0)
+            state->duplicates += eliminateDuplicates(state, options->dedupEpsilon);
+        t = lapPhase(state, PHASE_SELECTION, t);
+
+        refinePopulation(state, data, options);
+        lapPhase(state, PHASE_REFINEMENT, t);
 
         //log message
         #if defined(DEBUG)
-        cout << "#" << generationNumber<< " Fitness: " << bestFitness << \
-        " Iterations without change: " << noChangeIter << endl;
+        cout << "#" << state->generationNumber<< " Fitness: " << state->bestFitness << \
+        " Iterations without change: " << state->noChangeIter << endl;
         #endif
 	}
 
-    int t2 = clock(); //stop timer
+    return done;
+}
+
+// Prints how far the run got when its time budget ran out
+static void reportProgress(const GAState *state)
+{
+    static const char *names[PHASE_COUNT] = {
+        "crossover", "mutation", "evaluation", "selection", "refinement"};
+
+    cout << "Time budget spent - generations: " << state->generationNumber
+         << " evaluations: " << state->evaluations
+         << " restarts: " << state->restarts;
+    if(state->interrupted)
+        cout << " (last generation interrupted)";
+    cout << endl << "Time in phases:";
+    for(int p=0; p<PHASE_COUNT; p++)
+        cout << " " << names[p] << " " << state->phaseTimes[p] << " s";
+    cout << endl;
+}
 
-    cout << "------------------------------------------------------------" << endl;    
+// Prints solution in the same format for all solvers
+static void printSolution(const float *solution, float bestFitness, int generations)
+{
+    cout << "------------------------------------------------------------" << endl;
     cout << "Finished! Found Solution:" << endl;
-    
-    //solution is first individual of population with the best params of a polynomial    
-    cout << "\tc0 = " << population[0] << endl \
-    << "\tc1 = " << population[1] << endl \
-    << "\tc2 = " << population[2] << endl \
-    << "\tc3 = " << population[3] << endl \
-    << "Best fitness: " << bestFitness << endl \
-    << "Generations: " << generationNumber << endl;
+
+    //solution with the best params of a polynomial
+    for(int j=0; j<genomeLen; j++)
+        cout << "\tc" << j << " = " << solution[j] << endl;
+
+    cout << "Best fitness: " << bestFitness << endl \
+    << "Generations: " << generations << endl;
+}
+
+static void usage()
+{
+    cerr << "Usage: $./cpu [options] inputFile" << endl
+         << "  --solver ga|ls|auto        GA, least squares, or least squares" << endl
+         << "                             if the problem is linear" << endl
+         << "  --engine ga|de|cmaes|pso|small" << endl
+         << "                             genetic algorithm, differential evolution," << endl
+         << "                             CMA-ES, particle swarm or GA with" << endl
+         << "                             compile-time sizes for tiny problems" << endl
+         << "  --population n             individuals in population" << endl
+         << "  --de-strategy rand|current-to-best" << endl
+         << "                             mutation of differential evolution" << endl
+         << "  --de-adaptive              JADE adaptation of F and CR" << endl
+         << "  --cma-lambda n             CMA-ES candidates per generation" << endl
+         << "  --pso-topology global|ring neighbourhood of particles" << endl
+         << "  --model expression         fit expression in x and c0, c1, ..." << endl
+         << "                             instead of the polynomial" << endl
+         << "  --dims d                   points have d coordinates and the value" << endl
+         << "  --degree p                 fit polynomial surface of total degree p" << endl
+         << "  --crossover one-point|blx|sbx|arithmetic|uniform" << endl
+         << "                             recombination of parents of the GA" << endl
+         << "  --mutation fixed|self-adaptive|one-fifth" << endl
+         << "                             fixed, self-adapted per gene or globally" << endl
+         << "                             controlled mutation step" << endl
+         << "  --mutation-rate p          mutate every gene with probability p," << endl
+         << "                             sampling only the mutated genes" << endl
+         << "  --portfolio n              race n GA configurations, keep the fittest" << endl
+         << "  --autotune file            time thread counts and tiles of fitness" << endl
+         << "                             evaluation, cache the fastest in file" << endl
+         << "  --on-stagnation stop|reinit|mutate" << endl
+         << "                             end the run, or restart population" << endl
+         << "                             keeping the elite when it stagnates" << endl
+         << "  --ipop factor              population growth at every restart" << endl
+         << "  --max-evaluations n        budget of fitness evaluations" << endl
+         << "  --time-budget seconds      budget of computation time" << endl
+         << "  --lamarck k                refine elite by least squares every k generations" << endl
+         << "  --local-search k           Levenberg-Marquardt on k fittest individuals" << endl
+         << "  --lm-steps n               local search steps per generation" << endl
+         << "  --jacobian analytic|fd     derivatives used by local search" << endl
+         << "  --stream                   stream binary input from disk" << endl
+         << "  --chunk points             points in one streamed chunk" << endl
+         << "  --online                   tail input ('-' is stdin) and refit" << endl
+         << "  --window points            refit on last points only" << endl
+         << "  --decay lambda             exponential forgetting per point" << endl
+         << "  --refit-interval seconds   time between refits" << endl
+         << "  --refit-generations n      generations per refit" << endl
+         << "  --checkpoint file          write checkpoints of GA state" << endl
+         << "  --checkpoint-every n       generations between checkpoints" << endl
+         << "  --restart file             continue from checkpoint" << endl
+         << "  --random-seed n            seed of random generator" << endl
+         << "  --seed-file file           start from known solutions" << endl
+         << "  --seed-perturbation s      stddev of noise added to solutions" << endl
+         << "  --seed-random fraction     fraction of random individuals" << endl
+         << "  --loss squared|absolute|huber|cauchy|weighted" << endl
+         << "                             loss of residuals summed by fitness" << endl
+         << "  --loss-scale s             Huber threshold, Cauchy scale" << endl
+         << "  --normalize                fit polynomial to points scaled to [-1, 1]," << endl
+         << "                             coefficients are transformed back" << endl
+         << "  --precision float|double|mixed|kahan" << endl
+         << "                             arithmetic of polynomial fitness: float," << endl
+         << "                             double, float model with double or" << endl
+         << "                             compensated sum of errors" << endl
+         << "  --weights file             weights of points of weighted loss" << endl
+         << "  --fitness-cache n          memoize fitness of n genomes" << endl
+         << "  --dedup epsilon            replace parents equal to fitter ones" << endl
+         << "                             (within grid cell epsilon, 0 - exact)" << endl;
+}
+
+// Parses command line into @options, returns false on invalid arguments
+static bool parseArguments(int argc, char **argv, Options *options)
+{
+    options->inputFile = NULL;
+    options->modelExpression = NULL;
+    options->dims = 1;
+    options->degree = 0;
+    options->solver = SOLVER_GA;
+    options->engine = ENGINE_GA;
+    options->populationSize = POPULATION_SIZE;
+    options->deAdaptive = false;
+    options->deCurrentToBest = false;
+    options->cmaLambda = 0;
+    options->psoRing = false;
+    options->crossover = CROSSOVER_ONE_POINT;
+    options->mutation = MUTATION_FIXED;
+    options->stagnation = STAGNATION_STOP;
+    options->ipopFactor = 1;
+    options->maxEvaluations = 0;
+    options->timeBudget = 0;
+    options->deadline = 0;
+    options->lamarckEvery = 0;
+    options->localSearchTop = 0;
+    options->lmSteps = 3;
+    options->jacobian = JACOBIAN_ANALYTIC;
+    options->stream = false;
+    options->chunkPoints = CHUNK_POINTS;
+    options->online = false;
+    options->window = 0;
+    options->decay = 1.0;
+    options->refitInterval = 2.0;
+    options->refitGenerations = 30;
+    options->checkpointFile = NULL;
+    options->checkpointEvery = 100;
+    options->restartFile = NULL;
+    options->randomSeed = 1;
+    options->seedFile = NULL;
+    options->seedPerturbation = seed_perturbation;
+    options->seedRandomFraction = seed_random_fraction;
+    options->loss = LOSS_SQUARED;
+    options->precision = PRECISION_FLOAT;
+    options->lossScale = loss_scale;
+    options->weightsFile = NULL;
+    options->normalize = false;
+    options->fitnessCache = 0;
+    options->dedupEpsilon = -1;
+    options->mutationRate = 0;
+    options->muIndividuals = mu_individuals;
+    options->sigmaIndividuals = sigma_individuals;
+    options->muGenes = mu_genes;
+    options->sigmaGenes = sigma_genes;
+    options->portfolio = 0;
+    options->tuneFile = NULL;
+
+    for(int i=1; i<argc; i++){
+        bool hasValue = i+1 < argc;
+        if(strcmp(argv[i], "--solver") == 0 && hasValue){
+            i++;
+            if(strcmp(argv[i], "ga") == 0)
+                options->solver = SOLVER_GA;
+            else if(strcmp(argv[i], "ls") == 0)
+                options->solver = SOLVER_LS;
+            else if(strcmp(argv[i], "auto") == 0)
+                options->solver = SOLVER_AUTO;
+            else
+                return false;
+        }
+        else if(strcmp(argv[i], "--population") == 0 && hasValue)
+            options->populationSize = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--engine") == 0 && hasValue){
+            i++;
+            if(strcmp(argv[i], "ga") == 0)
+                options->engine = ENGINE_GA;
+            else if(strcmp(argv[i], "de") == 0)
+                options->engine = ENGINE_DE;
+            else if(strcmp(argv[i], "cmaes") == 0)
+                options->engine = ENGINE_CMAES;
+            else if(strcmp(argv[i], "pso") == 0)
+                options->engine = ENGINE_PSO;
+            else if(strcmp(argv[i], "small") == 0)
+                options->engine = ENGINE_SMALL;
+            else
+                return false;
+        }
+        else if(strcmp(argv[i], "--de-strategy") == 0 && hasValue){
+            i++;
+            if(strcmp(argv[i], "rand") == 0)
+                options->deCurrentToBest = false;
+            else if(strcmp(argv[i], "current-to-best") == 0)
+                options->deCurrentToBest = true;
+            else
+                return false;
+        }
+        else if(strcmp(argv[i], "--de-adaptive") == 0)
+            options->deAdaptive = true;
+        else if(strcmp(argv[i], "--cma-lambda") == 0 && hasValue)
+            options->cmaLambda = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--pso-topology") == 0 && hasValue){
+            i++;
+            if(strcmp(argv[i], "global") == 0)
+                options->psoRing = false;
+            else if(strcmp(argv[i], "ring") == 0)
+                options->psoRing = true;
+            else
+                return false;
+        }
+        else if(strcmp(argv[i], "--model") == 0 && hasValue)
+            options->modelExpression = argv[++i];
+        else if(strcmp(argv[i], "--dims") == 0 && hasValue)
+            options->dims = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--degree") == 0 && hasValue)
+            options->degree = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--crossover") == 0 && hasValue){
+            i++;
+            if(strcmp(argv[i], "one-point") == 0)
+                options->crossover = CROSSOVER_ONE_POINT;
+            else if(strcmp(argv[i], "blx") == 0)
+                options->crossover = CROSSOVER_BLX;
+            else if(strcmp(argv[i], "sbx") == 0)
+                options->crossover = CROSSOVER_SBX;
+            else if(strcmp(argv[i], "arithmetic") == 0)
+                options->crossover = CROSSOVER_ARITHMETIC;
+            else if(strcmp(argv[i], "uniform") == 0)
+                options->crossover = CROSSOVER_UNIFORM;
+            else
+                return false;
+        }
+        else if(strcmp(argv[i], "--mutation") == 0 && hasValue){
+            i++;
+            if(strcmp(argv[i], "fixed") == 0)
+                options->mutation = MUTATION_FIXED;
+            else if(strcmp(argv[i], "self-adaptive") == 0)
+                options->mutation = MUTATION_SELF_ADAPTIVE;
+            else if(strcmp(argv[i], "one-fifth") == 0)
+                options->mutation = MUTATION_ONE_FIFTH;
+            else
+                return false;
+        }
+        else if(strcmp(argv[i], "--on-stagnation") == 0 && hasValue){
+            i++;
+            if(strcmp(argv[i], "stop") == 0)
+                options->stagnation = STAGNATION_STOP;
+            else if(strcmp(argv[i], "reinit") == 0)
+                options->stagnation = STAGNATION_REINIT;
+            else if(strcmp(argv[i], "mutate") == 0)
+                options->stagnation = STAGNATION_MUTATE;
+            else
+                return false;
+        }
+        else if(strcmp(argv[i], "--ipop") == 0 && hasValue)
+            options->ipopFactor = atof(argv[++i]);
+        else if(strcmp(argv[i], "--max-evaluations") == 0 && hasValue)
+            options->maxEvaluations = atoll(argv[++i]);
+        else if(strcmp(argv[i], "--time-budget") == 0 && hasValue)
+            options->timeBudget = atof(argv[++i]);
+        else if(strcmp(argv[i], "--lamarck") == 0 && hasValue)
+            options->lamarckEvery = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--local-search") == 0 && hasValue)
+            options->localSearchTop = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--lm-steps") == 0 && hasValue)
+            options->lmSteps = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--jacobian") == 0 && hasValue){
+            i++;
+            if(strcmp(argv[i], "analytic") == 0)
+                options->jacobian = JACOBIAN_ANALYTIC;
+            else if(strcmp(argv[i], "fd") == 0)
+                options->jacobian = JACOBIAN_FD;
+            else
+                return false;
+        }
+        else if(strcmp(argv[i], "--stream") == 0)
+            options->stream = true;
+        else if(strcmp(argv[i], "--chunk") == 0 && hasValue)
+            options->chunkPoints = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--online") == 0)
+            options->online = true;
+        else if(strcmp(argv[i], "--window") == 0 && hasValue)
+            options->window = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--decay") == 0 && hasValue)
+            options->decay = atof(argv[++i]);
+        else if(strcmp(argv[i], "--refit-interval") == 0 && hasValue)
+            options->refitInterval = atof(argv[++i]);
+        else if(strcmp(argv[i], "--refit-generations") == 0 && hasValue)
+            options->refitGenerations = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--checkpoint") == 0 && hasValue)
+            options->checkpointFile = argv[++i];
+        else if(strcmp(argv[i], "--checkpoint-every") == 0 && hasValue)
+            options->checkpointEvery = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--restart") == 0 && hasValue)
+            options->restartFile = argv[++i];
+        else if(strcmp(argv[i], "--random-seed") == 0 && hasValue)
+            options->randomSeed = strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--seed-file") == 0 && hasValue)
+            options->seedFile = argv[++i];
+        else if(strcmp(argv[i], "--seed-perturbation") == 0 && hasValue)
+            options->seedPerturbation = atof(argv[++i]);
+        else if(strcmp(argv[i], "--loss") == 0 && hasValue){
+            i++;
+            if(strcmp(argv[i], "squared") == 0)
+                options->loss = LOSS_SQUARED;
+            else if(strcmp(argv[i], "absolute") == 0)
+                options->loss = LOSS_ABSOLUTE;
+            else if(strcmp(argv[i], "huber") == 0)
+                options->loss = LOSS_HUBER;
+            else if(strcmp(argv[i], "cauchy") == 0)
+                options->loss = LOSS_CAUCHY;
+            else if(strcmp(argv[i], "weighted") == 0)
+                options->loss = LOSS_WEIGHTED;
+            else
+                return false;
+        }
+        else if(strcmp(argv[i], "--normalize") == 0)
+            options->normalize = true;
+        else if(strcmp(argv[i], "--precision") == 0 && hasValue){
+            i++;
+            if(strcmp(argv[i], "float") == 0)
+                options->precision = PRECISION_FLOAT;
+            else if(strcmp(argv[i], "double") == 0)
+                options->precision = PRECISION_DOUBLE;
+            else if(strcmp(argv[i], "mixed") == 0)
+                options->precision = PRECISION_MIXED;
+            else if(strcmp(argv[i], "kahan") == 0)
+                options->precision = PRECISION_KAHAN;
+            else
+                return false;
+        }
+        else if(strcmp(argv[i], "--loss-scale") == 0 && hasValue)
+            options->lossScale = atof(argv[++i]);
+        else if(strcmp(argv[i], "--weights") == 0 && hasValue)
+            options->weightsFile = argv[++i];
+        else if(strcmp(argv[i], "--fitness-cache") == 0 && hasValue)
+            options->fitnessCache = atoll(argv[++i]);
+        else if(strcmp(argv[i], "--dedup") == 0 && hasValue){
+            options->dedupEpsilon = atof(argv[++i]);
+            if(options->dedupEpsilon < 0)
+                return false;
+        }
+        else if(strcmp(argv[i], "--mutation-rate") == 0 && hasValue)
+            options->mutationRate = atof(argv[++i]);
+        else if(strcmp(argv[i], "--portfolio") == 0 && hasValue)
+            options->portfolio = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--autotune") == 0 && hasValue)
+            options->tuneFile = argv[++i];
+        else if(strcmp(argv[i], "--seed-random") == 0 && hasValue)
+            options->seedRandomFraction = atof(argv[++i]);
+        else if((argv[i][0] != '-' || strcmp(argv[i], "-") == 0)
+                && options->inputFile == NULL)
+            options->inputFile = argv[i];
+        else
+            return false;
+    }
+
+    return options->inputFile != NULL
+        && options->chunkPoints >= 1
+        && options->window >= 0
+        && options->decay > 0 && options->decay <= 1
+        && options->refitInterval > 0
+        && options->refitGenerations >= 1
+        && options->cmaLambda >= 0
+        && options->dims >= 1 && options->dims <= MAX_GENOME_LEN
+        && options->degree >= 0 && options->degree <= MAX_GENOME_LEN
+        && options->ipopFactor >= 1
+        && options->maxEvaluations >= 0
+        && options->timeBudget >= 0
+        && options->lamarckEvery >= 0
+        && options->localSearchTop >= 0
+        && options->lmSteps >= 1
+        && options->checkpointEvery >= 1
+        && options->seedPerturbation >= 0
+        && options->seedRandomFraction >= 0 && options->seedRandomFraction <= 1
+        && options->lossScale > 0
+        && options->fitnessCache >= 0
+        && options->mutationRate >= 0 && options->mutationRate <= 1
+        && options->portfolio >= 0
+        && (options->portfolio == 0 || options->engine == ENGINE_GA)
+        && options->populationSize >= 4 && options->populationSize % 2 == 0
+        && (options->engine != ENGINE_SMALL
+            || (options->crossover == CROSSOVER_ONE_POINT
+                && options->mutation == MUTATION_FIXED && options->mutationRate == 0
+                && options->dedupEpsilon < 0 && options->fitnessCache == 0
+                && options->lamarckEvery == 0 && options->localSearchTop == 0
+                && options->ipopFactor == 1))
+        && (options->loss == LOSS_WEIGHTED) == (options->weightsFile != NULL)
+        && (options->precision == PRECISION_FLOAT
+            || (options->modelExpression == NULL && options->dims == 1
+                && options->degree == 0 && options->engine != ENGINE_SMALL))
+        && (!options->normalize
+            || (options->modelExpression == NULL && options->dims == 1
+                && options->degree == 0 && !options->online
+                && (options->loss == LOSS_SQUARED || options->loss == LOSS_WEIGHTED)));
+}
+
+/*
+    Main body of the GA
+*/
+int main(int argc, char **argv)
+{
+    Options options;
+    if(!parseArguments(argc, argv, &options)){
+        usage();
+        return -1;
+    }
+    seedRng(&globalRng, options.randomSeed);
+
+    //online refit keeps sufficient statistics of squared errors only
+    lossFunction = options.loss;
+    lossScale = options.lossScale;
+    precision = options.precision;
+    if(options.online && options.loss != LOSS_SQUARED){
+        cerr << "Online refit needs squared loss!!!" << endl;
+        return -1;
+    }
+
+    //user model replaces the polynomial, genome holds its coefficients
+    Expression *model = NULL;
+    if(options.modelExpression != NULL){
+        model = compileExpression(options.modelExpression);
+        if(model == NULL)
+            return -1;
+        if(model->nParams == 0){
+            cerr << "Model has no coefficients!!!" << endl;
+            return -1;
+        }
+        if(options.online || options.solver == SOLVER_LS){
+            cerr << "Online refit and least squares need the polynomial model!!!" << endl;
+            return -1;
+        }
+        userModel = model;
+        genomeLen = model->nParams;
+    }
+
+    //surface has one coefficient per monomial
+    bool surface = options.dims > 1 || options.degree > 0;
+    if(surface){
+        if(options.degree == 0)
+            options.degree = INDIVIDUAL_LEN - 1;
+        if(model != NULL || options.online){
+            cerr << "Surface cannot be combined with --model or --online!!!" << endl;
+            return -1;
+        }
+        genomeLen = monomialCount(options.dims, options.degree);
+        if(genomeLen > MAX_GENOME_LEN){
+            cerr << "Surface has more than MAX_GENOME_LEN terms!!!" << endl;
+            return -1;
+        }
+    }
+
+    //known solutions to start from
+    float *seeds = NULL;
+    int nSeeds = 0;
+    if(options.seedFile != NULL){
+        seeds = readSeeds(options.seedFile, &nSeeds);
+        if(seeds == NULL)
+            return -1;
+    }
+
+    //points arrive continuously, refit warm population periodically
+    if(options.online){
+        GAState *state = createGAState(options.populationSize);
+        if(seeds != NULL)
+            seedPopulation(state, seeds, nSeeds, options.seedPerturbation,
+                           options.seedRandomFraction);
+        else
+            initPopulation(state);
+        delete [] seeds;
+        int err = runOnline(&options, state);
+        freeGAState(state);
+        return err;
+    }
+
+    //read input data
+    //points are the data to approximate by a polynomial,
+    //binary point files not fitting into memory are streamed
+    Dataset data = {NULL, 0, NULL, NULL, NULL, NULL, NULL, 1};
+    const char *inputFile = options.inputFile;
+
+    if(surface){
+        if(isBinaryInput(inputFile)){
+            cerr << "Surface points must be in a text file!!!" << endl;
+            return -1;
+        }
+        data.surface = readSurface(inputFile, options.dims, options.degree);
+        if(data.surface == NULL)
+            return -1;
+        data.nPoints = data.surface->nPoints;
+
+        cout << "Surface - " << data.nPoints << " points, terms:";
+        for(int m=0; m<genomeLen; m++){
+            cout << " c" << m << "=";
+            printMonomial(data.surface, m);
+        }
+        cout << endl;
+        if(options.localSearchTop > 0)
+            cerr << "Local search is not available for surfaces, it is disabled!!!" << endl;
+    }else if(isBinaryInput(inputFile)){
+        data.stream = openPointStream(inputFile, options.chunkPoints);
+        if(data.stream == NULL)
+            return -1;
+        data.nPoints = data.stream->count;
+
+        if(!options.stream && pointsFitInMemory(data.nPoints)){
+            data.points = loadPointStream(data.stream);
+            closePointStream(data.stream);
+            data.stream = NULL;
+            if(data.points == NULL)
+                return -1;
+            cout << "Reading file - success!" << endl;
+        }else{
+            cout << "Streaming file - " << data.nPoints << " points in chunks of "
+                 << data.stream->chunkPoints << endl;
+            if(options.localSearchTop > 0)
+                cerr << "Local search needs points in memory, it is disabled!!!" << endl;
+        }
+    }else{
+        int pointsRead;
+        data.points = readData(inputFile, N_POINTS, &pointsRead);
+        if(data.points == NULL)
+            return -1;
+        data.nPoints = pointsRead;
+    }
+
+    if(options.weightsFile != NULL){
+        if(data.stream != NULL){
+            cerr << "Weighted loss needs points in memory!!!" << endl;
+            return -1;
+        }
+        data.weights = readWeights(options.weightsFile, data.nPoints);
+        if(data.weights == NULL)
+            return -1;
+    }
+
+    //solvers work on normalized copy of points, solutions are reported
+    //in original units on original points
+    Dataset original = data;
+    Normalization normalization;
+    if(options.normalize){
+        if(data.points == NULL){
+            cerr << "Normalization needs points in memory!!!" << endl;
+            return -1;
+        }
+        data.points = new float[2*data.nPoints];
+        memcpy(data.points, original.points, 2*data.nPoints*sizeof(float));
+        normalization = normalizePoints(data.points, data.nPoints);
+        data.fitnessScale = normalization.yScale*normalization.yScale;
+        for(int s=0; s<nSeeds; s++)
+            normalizeCoefficients(&normalization, &seeds[s*genomeLen], &seeds[s*genomeLen]);
+        cout << "Normalization - x: (x - " << normalization.xCenter << ")/"
+             << normalization.xScale << " f(x): (f(x) - " << normalization.yCenter
+             << ")/" << normalization.yScale << endl;
+    }
+
+    //linear problem is answered directly
+    if(options.solver == SOLVER_LS && !isLinearProblem()){
+        cerr << "Least squares needs squared loss!!!" << endl;
+        return -1;
+    }
+    if(options.solver == SOLVER_LS
+       || (options.solver == SOLVER_AUTO && isLinearProblem())){
+        float solution[MAX_GENOME_LEN];
+        float bestFitness;
+
+        double t1 = omp_get_wtime(); //start timer
+        bool solved = leastSquaresFit(&data, solution);
+        double t2 = omp_get_wtime(); //stop timer
+
+        if(solved){
+            if(options.normalize)
+                denormalizeCoefficients(&normalization, solution, solution);
+            evaluate(&original, solution, 1, &bestFitness);
+            printSolution(solution, bestFitness, 0);
+            cout << "Time for least-squares solution equals \033[35m" \
+                << (t2-t1) << " seconds\033[0m" << endl;
+        }else
+            cerr << "Points do not determine all coefficients!!!" << endl;
+
+        delete [] seeds;
+        if(data.points != original.points)
+            delete [] original.points;
+        delete [] data.points;
+        delete [] data.weights;
+        if(data.stream != NULL)
+            closePointStream(data.stream);
+        if(data.surface != NULL)
+            freeSurface(data.surface);
+        return solved ? 0 : -1;
+    }
+
+    if(options.fitnessCache > 0)
+        data.cache = createFitnessCache(options.fitnessCache);
+
+    if(options.tuneFile != NULL)
+        autotune(options.tuneFile, &data, &options);
+
+    double t1 = omp_get_wtime(); //start timer
+    if(options.timeBudget > 0)
+        options.deadline = t1 + options.timeBudget;
+
+    //population is either restored from checkpoint, raced or random
+    GAState *state;
+    if(options.restartFile != NULL){
+        state = readCheckpoint(options.restartFile, options.engine);
+        if(state == NULL)
+            return -1;
+    }else if(options.portfolio > 0){
+        state = runPortfolio(&data, &options, seeds, nSeeds);
+    }else{
+        state = createGAState(options.populationSize);
+        if(seeds != NULL)
+            seedPopulation(state, seeds, nSeeds, options.seedPerturbation,
+                           options.seedRandomFraction);
+        else
+            initPopulation(state);
+    }
+    delete [] seeds;
+
+    if(options.engine == ENGINE_SMALL && !smallEngineSupports(&data, state->size)){
+        cerr << "Small engine needs population of 128, 256 or 512 and at most 512 "
+                "points of the polynomial in memory with squared loss!!!" << endl;
+        freeGAState(state);
+        return -1;
+    }
+
+    CheckpointWriter *checkpoint = NULL;
+    if(options.checkpointFile != NULL)
+        checkpoint = createCheckpointWriter(options.checkpointFile);
+
+    //without checkpoints all generations are run at once
+    int remaining = maxGenerationNumber - state->generationNumber;
+    while(remaining > 0)
+    {
+        int block = checkpoint != NULL ? min(options.checkpointEvery, remaining) : remaining;
+        int done = runEngine(state, &data, block, &options);
+        remaining -= done;
+
+        //read error ends the run, the last checkpoint stays valid
+        if(datasetFailed(&data))
+            break;
+
+        if(checkpoint != NULL)
+            writeCheckpoint(checkpoint, state, options.engine);
+
+        //stopped by convergence criteria
+        if(done < block){
+            //stagnated population is restarted while there is budget left
+            if(options.stagnation != STAGNATION_STOP && state->noChangeIter >= maxConstIter
+               && !budgetExhausted(state, &options)){
+                state = restartPopulation(state, &options);
+                cout << "Restart #" << state->restarts << " generation: "
+                     << state->generationNumber << " population: " << state->size
+                     << " best fitness: " << state->bestFitness << endl;
+                continue;
+            }
+            break;
+        }
+    }
+
+    double t2 = omp_get_wtime(); //stop timer
+
+    if(checkpoint != NULL)
+        freeCheckpointWriter(checkpoint);
+
+    if(datasetFailed(&data)){
+        cerr << "Run stopped, points could not be read!!!" << endl;
+        freeGAState(state);
+        return -1;
+    }
+
+    //anytime result, report how far the run got within its budget
+    if(options.deadline > 0 && t2 >= options.deadline)
+        reportProgress(state);
+
+    //solution is first individual of population with the best params of a polynomial
+    if(options.normalize){
+        float solution[INDIVIDUAL_LEN];
+        float fitness;
+        denormalizeCoefficients(&normalization, state->population, solution);
+        evaluate(&original, solution, 1, &fitness);
+        printSolution(solution, fitness, state->generationNumber);
+    }else
+        printSolution(state->population, state->bestFitness, state->generationNumber);
 
     cout << "Time for CPU calculation equals \033[35m" \
-        << (t2-t1)/(double)CLOCKS_PER_SEC << " seconds\033[0m" << endl;
+        << (t2-t1) << " seconds\033[0m" << endl;
+
+    if(options.dedupEpsilon >= 0)
+        cout << "Duplicates replaced: " << state->duplicates << endl;
 
-    delete [] current_fitnesses;
-    delete [] population;
-    delete [] newPopulation;
-    delete [] points;
+    if(data.cache != NULL)
+        cout << "Fitness cache - hits: " << data.cache->hits << " of "
+             << data.cache->lookups << " lookups ("
+             << 100.0*data.cache->hits/max(data.cache->lookups, 1LL) << "%)" << endl;
 
-	return 0;
+    //least-squares optimum is the reference accuracy of linear problems,
+    //runs with time budget do not spend time on it
+    float optimum[MAX_GENOME_LEN];
+    if(options.deadline == 0 && isLinearProblem() && leastSquaresFit(&data, optimum)){
+        float optimumFitness;
+        if(options.normalize)
+            denormalizeCoefficients(&normalization, optimum, optimum);
+        evaluate(&original, optimum, 1, &optimumFitness);
+        cout << "Least-squares optimum fitness: " << optimumFitness << endl;
+    }
+
+    freeGAState(state);
+    if(data.points != original.points)
+        delete [] original.points;
+    delete [] data.points;
+    delete [] data.weights;
+    if(data.stream != NULL)
+        closePointStream(data.stream);
+    if(data.surface != NULL)
+        freeSurface(data.surface);
+    if(data.cache != NULL)
+        freeFitnessCache(data.cache);
+    if(model != NULL)
+        freeExpression(model);
+
+    return 0;
 }
 
 //------------------------------------------------------------------------------
+Rng globalRng = {1};
+int genomeLen = INDIVIDUAL_LEN;
+LossFunction lossFunction = LOSS_SQUARED;
+float lossScale = loss_scale;
+Precision precision = PRECISION_FLOAT;
+const Expression *userModel = NULL;
+
+void seedRng(Rng *rng, unsigned long long seed)
+{
+    //splitmix64 scrambles seed, so that even close seeds give unrelated streams
+    unsigned long long z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+
+    //state of xorshift must not be zero
+    rng->state = z ? z : 1;
+}
+
+unsigned int rngNext(Rng *rng)
+{
+    //xorshift64*, upper bits of the product are the best ones
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return (rng->state * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+float rngUniform(Rng *rng)
+{
+    //24 bits fit float exactly, so the result never rounds up to 1
+    return (rngNext(rng) >> 8) * (1.0f/16777216.0f);
+}
+
+float rngNormal(Rng *rng)
+{
+    //polar Box-Muller, second value of the pair is dropped
+    float V1, V2, S;
+    do{
+        V1 = 2*rngUniform(rng) - 1;
+        V2 = 2*rngUniform(rng) - 1;
+        S = V1*V1 + V2*V2;
+    }while(S >= 1 || S == 0);
+    return V1 * sqrt(-2*log(S)/S);
+}
+
+void rngNormals(Rng *rng, float *out, int n)
+{
+    for(int i=0; i<n; i+=2){
+        float V1, V2, S;
+        do{
+            V1 = 2*rngUniform(rng) - 1;
+            V2 = 2*rngUniform(rng) - 1;
+            S = V1*V1 + V2*V2;
+        }while(S >= 1 || S == 0);
+
+        float factor = sqrt(-2*log(S)/S);
+        out[i] = V1*factor;
+        if(i+1 < n)
+            out[i+1] = V2*factor;
+    }
+}
+
 float frand() 
 {
-	return float(rand())/RAND_MAX;
+	return rngUniform(&globalRng);
 }
 
 float stdrand() //Box–Muller transform
 {
     float U1, U2,V1, V2;
     float S=2;
-    while (S>=1){
+    while (S>=1 || S==0){
         U1 = frand();
         U2 = frand();
         V1 = -1.0 + 2.0*U1;
@@ -333,25 +1789,119 @@ float nrand(float mu, float sigma)
     return X2;
 }
 
-float *readData(const char *name, const int POINTS_CNT)
+float *readSeeds(const char *name, int *nSeeds)
 {
     FILE *file = fopen(name,"r");
- 
-	float *points = new float[2*POINTS_CNT]; 
-    if (file != NULL){
+    if (file == NULL){
+        cerr << "Error while opening the file " << name << "!!!" << endl;
+        return NULL;
+    }
 
-        int k=0;
-        //x, f(x)
-        while(fscanf(file,"%f %f",&points[k],&points[POINTS_CNT+k])!= EOF){
-            k++;
+    int capacity = 16;
+    float *seeds = new float[capacity*genomeLen];
+    int k = 0;
+
+    //c0 c1 ... on each line
+    float seed[MAX_GENOME_LEN];
+    bool complete = true;
+    while(complete){
+        for(int j=0; j<genomeLen && complete; j++)
+            complete = fscanf(file, "%f", &seed[j]) == 1;
+        if(!complete)
+            break;
+
+        if(k == capacity){
+            float *grown = new float[2*capacity*genomeLen];
+            memcpy(grown, seeds, capacity*genomeLen*sizeof(float));
+            delete [] seeds;
+            seeds = grown;
+            capacity *= 2;
         }
-        fclose(file);
-        cout << "Reading file - success!" << endl;
-    }else{
+        memcpy(&seeds[k*genomeLen], seed, genomeLen*sizeof(float));
+        k++;
+    }
+    fclose(file);
+
+    if(k == 0){
+        cerr << "No solution found in the file " << name << "!!!" << endl;
+        delete [] seeds;
+        return NULL;
+    }
+
+    *nSeeds = k;
+    return seeds;
+}
+
+float *readWeights(const char *name, long long nPoints)
+{
+    FILE *file = fopen(name,"r");
+    if (file == NULL){
+        cerr << "Error while opening the file " << name << "!!!" << endl;
+        return NULL;
+    }
+
+    //one weight per line, in the order of points
+    float *weights = new float[nPoints];
+    long long k = 0;
+    float w;
+    while(fscanf(file, "%f", &w) == 1 && k <= nPoints){
+        if(k < nPoints)
+            weights[k] = w;
+        k++;
+    }
+    fclose(file);
+
+    if(k != nPoints){
+        cerr << "Number of weights in the file " << name
+             << " differs from number of points!!!" << endl;
+        delete [] weights;
+        return NULL;
+    }
+
+    return weights;
+}
+
+float *readData(const char *name, const int POINTS_CNT, int *pointsRead)
+{
+    FILE *file = fopen(name,"r");
+ 
+    if (file == NULL){
         cerr << "Error while opening the file " << name << "!!!" << endl;
-        delete [] points;
         return NULL;
     }
 
+    //x and f(x) are read into separate buffers doubled when full
+    int capacity = POINTS_CNT;
+    float *x = new float[capacity];
+    float *fx = new float[capacity];
+    int k=0;
+    float a, b;
+    while(fscanf(file,"%f %f",&a,&b) == 2){
+        if(k == capacity){
+            float *grownX = new float[2*capacity];
+            float *grownFx = new float[2*capacity];
+            memcpy(grownX, x, capacity*sizeof(float));
+            memcpy(grownFx, fx, capacity*sizeof(float));
+            delete [] x;
+            delete [] fx;
+            x = grownX;
+            fx = grownFx;
+            capacity *= 2;
+        }
+        x[k] = a;
+        fx[k] = b;
+        k++;
+    }
+    fclose(file);
+
+    //points in [x..., f(x)...] layout without gap
+    float *points = new float[2*k];
+    memcpy(points, x, k*sizeof(float));
+    memcpy(&points[k], fx, k*sizeof(float));
+    delete [] x;
+    delete [] fx;
+
+    *pointsRead = k;
+    cout << "Reading file - success!" << endl;
     return points;
 }
@@ -0,0 +1,599 @@
+// Forward declarations shared by the modules of the CPU version
+
+/**
+    Pseudo random generator (xorshift64*). Its whole state is one word,
+    so it can be stored in checkpoint and restored exactly.
+*/
+struct Rng
+{
+    unsigned long long state;
+};
+
+// Generator used by the GA operators
+extern Rng globalRng;
+
+// Number of coefficients of the fitted model, INDIVIDUAL_LEN for polynomial,
+// number of monomials for surface
+extern int genomeLen;
+
+// Model given by --model, NULL for the built-in polynomial
+struct Expression;
+extern const Expression *userModel;
+
+// Initializes generator from arbitrary seed
+void seedRng(Rng *rng, unsigned long long seed);
+
+// Returns next 32 random bits
+unsigned int rngNext(Rng *rng);
+
+// Returns random number from interval <0.0, 1.0)
+float rngUniform(Rng *rng);
+
+// Returns random number with standard normal distribution
+float rngNormal(Rng *rng);
+
+// Fills @out with @n random numbers with standard normal distribution,
+// both values of every Box-Muller pair are used
+void rngNormals(Rng *rng, float *out, int n);
+
+// Generages random no. with normal distribution
+float nrand(float mu, float sigma);
+
+// Box–Muller transform
+float stdrand();
+
+// Returns random number from interval <0.0, 1.0) drawn from globalRng
+float frand();
+
+// Reads input file with noisy points. Points will be approximated by
+// polynomial function using GA. Buffer for POINTS_CNT points is doubled
+// when full, number of points actually read is returned in @pointsRead.
+float *readData(const char *name, const int POINTS_CNT, int *pointsRead);
+
+/**
+    Loss of residuals summed by fitness kernels
+*/
+enum LossFunction
+{
+    LOSS_SQUARED,
+    LOSS_ABSOLUTE,
+    LOSS_HUBER,         // quadratic up to lossScale, linear beyond
+    LOSS_CAUCHY,        // logarithmic beyond lossScale
+    LOSS_WEIGHTED       // squared errors multiplied by weights of points
+};
+
+extern LossFunction lossFunction;
+extern float lossScale;
+
+/**
+    Arithmetic of the polynomial fitness kernel
+*/
+enum Precision
+{
+    PRECISION_FLOAT,    // model and sum of errors in float
+    PRECISION_DOUBLE,   // model and sum of errors in double
+    PRECISION_MIXED,    // model in float, sum of errors in double
+    PRECISION_KAHAN     // model in float, compensated float sum
+};
+
+extern Precision precision;
+
+// Evaluates fitness of @size individuals on @nPoints points held in memory,
+// returns NULL if @deadline (omp_get_wtime(), 0 - none) passes before all
+// chunks of points are evaluated. @weights are used by LOSS_WEIGHTED only.
+float *fitness(float *individuals, int size, float *points, long long nPoints,
+               const float *weights, float *current_fitnesses, double deadline);
+
+// Adds errors of @size individuals over one chunk of @count points with
+// weights @w to @fitnesses, returns false if @deadline (0 - none) passed
+// meanwhile and some individuals were skipped
+bool fitnessChunk(const float *individuals, int size,
+                  const float *x, const float *y, const float *w, int count,
+                  float *fitnesses, double deadline);
+
+
+/**
+    Out-of-core input data
+
+    Binary point file is a sequence of (x, f(x)) float pairs. Files that
+    do not fit into memory are streamed chunk by chunk while the next
+    chunk is prefetched by a helper thread.
+*/
+struct Prefetcher;
+
+struct PointStream
+{
+    int fd;                 // file descriptor of binary point file
+    long long count;        // number of points in file
+    int chunkPoints;        // number of points in one chunk
+    float *buffers[2];      // double buffer, chunk points stored as [x..., y...]
+    float *raw[2];          // staging buffers for interleaved (x, y) pairs
+    Prefetcher *prefetcher; // helper thread reading the next chunk
+    int nextBuffer;         // buffer receiving chunk 0 of the next pass, -1 if none
+    bool failed;            // file could not be read, the run must stop
+};
+
+// Opens binary point file for streaming, returns NULL on failure
+PointStream *openPointStream(const char *name, int chunkPoints);
+
+// Closes point stream and frees its buffers
+void closePointStream(PointStream *stream);
+
+// Reads whole binary point file into memory in the layout of readData
+float *loadPointStream(PointStream *stream);
+
+// Returns true if binary point file of @count points fits into memory
+bool pointsFitInMemory(long long count);
+
+// Evaluates fitness of @size individuals by streaming all points of @stream,
+// returns NULL if @deadline passes before all chunks are evaluated or if
+// the file cannot be read, the latter also sets stream->failed
+float *streamFitness(PointStream *stream, float *individuals, int size,
+                     float *current_fitnesses, double deadline);
+
+
+/**
+    Sufficient statistics of weighted points for polynomial model
+
+    Sum of squared errors of polynomial with coefficients c is
+    SSE(c) = yy - 2 sum_i c_i yxPow[i] + sum_i sum_j c_i c_j xPow[i+j],
+    so fitness does not depend on number of points and statistics can be
+    updated incrementally as points arrive or leave.
+*/
+struct PolyStats
+{
+    double xPow[2*INDIVIDUAL_LEN - 1];  // sum of w*x^k
+    double yxPow[INDIVIDUAL_LEN];       // sum of w*y*x^k
+    double yy;                          // sum of w*y^2
+    double weight;                      // sum of w, effective number of points
+};
+
+// Resets statistics to empty set of points
+void clearPolyStats(PolyStats *stats);
+
+// Adds point with weight @w to statistics, negative weight removes the point
+void addPolyStatsPoint(PolyStats *stats, float x, float y, double w);
+
+// Multiplies weight of all points in statistics by @lambda
+void decayPolyStats(PolyStats *stats, double lambda);
+
+// Evaluates fitness of @size individuals from sufficient statistics
+float *statsFitness(const PolyStats *stats, float *individuals, int size,
+                    float *current_fitnesses);
+
+// Computes statistics of all points in binary point file, returns false
+// if the file cannot be read
+bool streamPolyStats(PointStream *stream, PolyStats *stats);
+
+
+/**
+    Memoized fitnesses, direct-mapped table indexed by hash of genome bits
+
+    Every slot is two words, the value (valid bit and fitness) and the full
+    hash xored with the value, read and written atomically word by word
+    without locks. Slot is overwritten by the newest genome mapped to it.
+*/
+struct FitnessCache
+{
+    unsigned long long *slots;  // key ^ value, value of every slot
+    long long mask;             // number of slots - 1, power of two
+    long long lookups;
+    long long hits;
+};
+
+// Creates cache with at least @entries slots
+FitnessCache *createFitnessCache(long long entries);
+
+void freeFitnessCache(FitnessCache *cache);
+
+// Hash of genomeLen coefficients of @genome
+unsigned long long genomeHash(const float *genome);
+
+// Returns true and cached fitness of genome with @hash if it is known
+bool cacheLookup(const FitnessCache *cache, unsigned long long hash, float *fitness);
+
+void cacheStore(FitnessCache *cache, unsigned long long hash, float fitness);
+
+
+/**
+    Data the fitness is evaluated on, exactly one form is used:
+    points held in memory, streamed binary file or sufficient statistics
+*/
+struct Surface;
+struct Dataset
+{
+    float *points;          // [x..., f(x)...] as returned by readData
+    long long nPoints;
+    PointStream *stream;
+    PolyStats *stats;
+    Surface *surface;       // points with more coordinates, see surface.h
+    float *weights;         // weight of every point, NULL if not weighted
+    FitnessCache *cache;    // fitnesses of evaluated genomes, NULL if off
+    double fitnessScale;    // original fitness per unit of fitness, 1 unless
+                            // points are normalized
+};
+
+// Evaluates fitness of @size individuals on data set
+float *evaluate(const Dataset *data, float *individuals, int size, float *fitnesses);
+
+// Evaluates fitness like evaluate(), but gives up and returns NULL when
+// @deadline passes in the middle of long evaluation, 0 means no deadline
+float *evaluateUntil(const Dataset *data, float *individuals, int size,
+                     float *fitnesses, double deadline);
+
+// Returns (effective) number of points in data set
+double datasetPoints(const Dataset *data);
+
+// Returns true if points of the data set could not be read, NULL returned
+// by evaluation is then an error, not the deadline
+bool datasetFailed(const Dataset *data);
+
+// Fitness at which the run stops, targetErrPerPoint in original units
+float fitnessTarget(const Dataset *data);
+
+
+/**
+    Affine maps of x and f(x) of normalized points
+*/
+struct Normalization
+{
+    double xCenter, xScale;     // normalized x = (x - xCenter)/xScale
+    double yCenter, yScale;
+};
+
+// Centers and scales x and f(x) of points in memory to [-1, 1]
+Normalization normalizePoints(float *points, long long nPoints);
+
+// Polynomial coefficients in original units of @normalized ones
+void denormalizeCoefficients(const Normalization *n, const float *normalized,
+                             float *coefficients);
+
+// Polynomial coefficients in normalized units of original ones
+void normalizeCoefficients(const Normalization *n, const float *coefficients,
+                           float *normalized);
+
+
+/**
+    Phases of one generation, time spent in them is measured
+*/
+enum Phase
+{
+    PHASE_CROSSOVER,
+    PHASE_MUTATION,
+    PHASE_EVALUATION,
+    PHASE_SELECTION,
+    PHASE_REFINEMENT,       // Lamarckian refinement and local search
+    PHASE_COUNT
+};
+
+
+// Adaptation state of CMA-ES engine
+struct CMAState;
+
+void freeCMAState(CMAState *cma);
+
+// Returns size of @cma serialized by saveCMAState() in bytes
+int cmaStateBytes(const CMAState *cma);
+
+// Serializes @cma into @buffer of cmaStateBytes() bytes
+void saveCMAState(const CMAState *cma, char *buffer);
+
+// Restores state serialized by saveCMAState(), NULL if @bytes do not match
+CMAState *loadCMAState(const char *buffer, int bytes);
+
+// Swarm state of particle swarm engine
+struct PSOState;
+
+void freePSOState(PSOState *pso);
+
+// Returns size of @pso serialized by savePSOState() in bytes
+int psoStateBytes(const PSOState *pso);
+
+// Serializes @pso into @buffer of psoStateBytes() bytes
+void savePSOState(const PSOState *pso, char *buffer);
+
+// Restores swarm serialized by savePSOState(), NULL if @bytes do not match
+PSOState *loadPSOState(const char *buffer, int bytes);
+
+
+/**
+    State of the GA carried from one generation to the next one
+*/
+struct GAState
+{
+    float *population;      // sorted by fitness after each generation
+    float *newPopulation;
+    float *fitnesses;
+    float *steps;           // mutation step of every gene, follows its gene
+    float *newSteps;
+    unsigned char *mutated; // individual was mutated in the last generation
+    float *parentFitnesses; // fitness of the fitter parent of every individual
+    int size;               // number of individuals
+    float mutationScale;    // global mutation step of 1/5th success rule
+    float deMeanF;          // adapted mean scale factor of differential evolution
+    float deMeanCR;         // adapted mean crossover rate
+    CMAState *cma;          // NULL until CMA-ES runs on the population
+    PSOState *pso;          // NULL until particle swarm runs on the population
+
+    int generationNumber;
+    int noChangeIter;
+    long long evaluations;  // fitness evaluations of individuals so far
+    long long duplicates;   // parents replaced by duplicate elimination
+    int restarts;
+    bool interrupted;       // last generation was cut by the deadline
+    double phaseTimes[PHASE_COUNT]; // seconds spent in phases
+    float bestFitness;
+    float previousBestFitness;
+};
+
+// Allocates state for population of @size individuals
+GAState *createGAState(int size);
+
+void freeGAState(GAState *state);
+
+// Fills population with random individuals
+void initPopulation(GAState *state);
+
+// Fills population with copies of @nSeeds known solutions perturbed by normal
+// noise with stddev @perturbation, the last @randomFraction of population is
+// random. Every seed is kept once unperturbed at the beginning of population.
+void seedPopulation(GAState *state, const float *seeds, int nSeeds,
+                    float perturbation, float randomFraction);
+
+// Reads known solutions, genomeLen coefficients per line
+float *readSeeds(const char *name, int *nSeeds);
+
+// Reads exactly @nPoints weights, one per point in order of input file
+float *readWeights(const char *name, long long nPoints);
+
+/**
+    Search algorithm evolving the population
+*/
+enum Engine
+{
+    ENGINE_GA,              // genetic algorithm
+    ENGINE_DE,              // differential evolution
+    ENGINE_CMAES,           // covariance matrix adaptation evolution strategy
+    ENGINE_PSO,             // particle swarm optimization
+    ENGINE_SMALL            // GA with compile-time sizes for tiny problems
+};
+
+
+/**
+    How the problem is solved
+*/
+enum Solver
+{
+    SOLVER_GA,      // genetic algorithm
+    SOLVER_LS,      // closed-form least squares
+    SOLVER_AUTO     // least squares when the problem is linear, GA otherwise
+};
+
+
+/**
+    What happens when the best fitness stagnates for maxConstIter generations
+*/
+enum Stagnation
+{
+    STAGNATION_STOP,        // end the run
+    STAGNATION_REINIT,      // keep elite, the rest is random again
+    STAGNATION_MUTATE       // keep elite, heavily mutate the rest
+};
+
+
+/**
+    How genes of two parents are recombined into children
+*/
+enum Crossover
+{
+    CROSSOVER_ONE_POINT,    // genes before a random crosspoint from one parent
+    CROSSOVER_BLX,          // blend, genes uniform around the interval of parents
+    CROSSOVER_SBX,          // simulated binary, spread like one-point on bits
+    CROSSOVER_ARITHMETIC,   // weighted mean of parents, random weight per pair
+    CROSSOVER_UNIFORM       // every gene from a random parent
+};
+
+
+/**
+    How the mutation step is chosen
+*/
+enum Mutation
+{
+    MUTATION_FIXED,         // uniform noise of mutation_step
+    MUTATION_SELF_ADAPTIVE, // per-gene steps evolved with the genome
+    MUTATION_ONE_FIFTH      // global step controlled by 1/5th success rule
+};
+
+
+/**
+    How the Jacobian of the model is computed by local search
+*/
+enum Jacobian
+{
+    JACOBIAN_ANALYTIC,      // derivatives of the polynomial model
+    JACOBIAN_FD             // central finite differences
+};
+
+
+/**
+    Command line options of the CPU version
+*/
+struct Options
+{
+    Solver solver;
+    Engine engine;
+    int populationSize;
+    bool deAdaptive;        // JADE adaptation of F and CR
+    bool deCurrentToBest;   // current-to-best/1 instead of rand/1 mutation
+    int cmaLambda;          // CMA-ES candidates per generation, 0 - default
+    bool psoRing;           // ring neighbourhood instead of global best
+    Crossover crossover;
+    Mutation mutation;
+    float mutationRate;     // probability of mutating a gene, sparse mutation
+                            // if > 0, 0 - built-in gene selection
+    float muIndividuals;    // mean and stddev of mutated genes of an individual
+    float sigmaIndividuals;
+    float muGenes;          // mean and stddev of threshold of mutating a gene
+    float sigmaGenes;
+    int portfolio;          // GA configurations raced at start, 0 - none
+    const char *tuneFile;   // tuning file of fitness evaluation, NULL - no tuning
+    int lamarckEvery;       // generations between least-squares refinements of elite, 0 - never
+    int localSearchTop;     // individuals refined by local search each generation, 0 - none
+    int lmSteps;            // Levenberg-Marquardt steps per individual
+    Jacobian jacobian;
+
+    Stagnation stagnation;
+    float ipopFactor;       // population growth at every restart
+    long long maxEvaluations;   // evaluation budget, 0 - unlimited
+    double timeBudget;      // seconds, 0 - unlimited
+    double deadline;        // omp_get_wtime() when time budget runs out, 0 - never,
+                            // callers embedding the GA may set it directly
+
+    const char *modelExpression;    // user model, NULL for the polynomial
+    int dims;               // coordinates of a point, surface if > 1
+    int degree;             // total degree of surface, 0 - built-in polynomial
+    const char *inputFile;
+    bool stream;            // stream binary input even if it fits into memory
+    int chunkPoints;        // points in one streamed chunk
+
+    bool online;            // tail input and refit periodically
+    int window;             // refit on last points only, 0 means all points
+    double decay;           // exponential forgetting factor per point
+    double refitInterval;   // seconds between refits
+    int refitGenerations;   // generations per refit of warm population
+
+    const char *checkpointFile; // write checkpoints into the file
+    int checkpointEvery;        // generations between checkpoints
+    const char *restartFile;    // continue from the checkpoint
+    unsigned long long randomSeed;
+
+    const char *seedFile;       // known solutions to start from
+    float seedPerturbation;     // stddev of noise added to known solutions
+    float seedRandomFraction;   // fraction of random individuals
+
+    LossFunction loss;
+    float lossScale;            // Huber delta, Cauchy scale
+    Precision precision;
+    const char *weightsFile;    // weights of points of weighted loss
+    bool normalize;             // fit polynomial to normalized points
+
+    long long fitnessCache;     // entries of fitness cache, 0 - no cache
+    float dedupEpsilon;         // grid spacing of duplicate elimination,
+                                // 0 - exact duplicates, negative - off
+};
+
+// Runs at most @generations generations of the GA, returns number of
+// generations done
+int runGenerations(GAState *state, const Dataset *data, int generations,
+                   const Options *options);
+
+// Runs at most @generations generations of differential evolution
+int runDifferentialEvolution(GAState *state, const Dataset *data, int generations,
+                             const Options *options);
+
+// Runs at most @generations generations of CMA-ES
+int runCMAES(GAState *state, const Dataset *data, int generations,
+             const Options *options);
+
+// Runs at most @generations generations of particle swarm
+int runParticleSwarm(GAState *state, const Dataset *data, int generations,
+                     const Options *options);
+
+// Returns true if the small engine has an instantiation for population of
+// @size individuals and the points of @data
+bool smallEngineSupports(const Dataset *data, int size);
+
+// Runs at most @generations generations of the GA with compile-time sizes
+int runSmallEngine(GAState *state, const Dataset *data, int generations,
+                   const Options *options);
+
+// Runs at most @generations generations of the selected engine. Every engine
+// keeps the fittest individual first in population and its fitness in
+// bestFitness, and stops on the same criteria as the GA.
+int runEngine(GAState *state, const Dataset *data, int generations,
+              const Options *options);
+
+// Returns true if the deadline has passed, omp_get_wtime() is monotonic
+bool deadlinePassed(const Options *options);
+
+// Returns true if evaluation or time budget of the run is spent
+bool budgetExhausted(const GAState *state, const Options *options);
+
+// Adds time since @start to @phase, returns current time
+double lapPhase(GAState *state, Phase phase, double start);
+
+// Counts generations without change of the best fitness
+void trackConvergence(GAState *state, const Dataset *data);
+
+// Applies Lamarckian refinement and local search selected by options
+void refinePopulation(GAState *state, const Dataset *data, const Options *options);
+
+// Restarts stagnated population, the elite is kept and population grows by
+// ipop factor, returns the new state (@state is freed if it had to grow)
+GAState *restartPopulation(GAState *state, const Options *options);
+
+// Sets thread count and surface tile of fitness evaluation from tuning @file,
+// or times the candidates on @data and appends the fastest to the file
+void autotune(const char *file, const Dataset *data, const Options *options);
+
+// Races options->portfolio GA configurations by successive halving, returns
+// state of the winner and stores its mutation parameters into @options
+GAState *runPortfolio(const Dataset *data, Options *options,
+                      const float *seeds, int nSeeds);
+
+// Tails input and periodically refits warm population, returns exit code
+int runOnline(const Options *options, GAState *state);
+
+
+// Writes GA state into checkpoint file in the background
+struct CheckpointWriter;
+
+CheckpointWriter *createCheckpointWriter(const char *fileName);
+
+// Takes snapshot of @state and writes it asynchronously, waits only
+// if the previous checkpoint is still being written
+void writeCheckpoint(CheckpointWriter *checkpoint, const GAState *state,
+                     Engine engine);
+
+// Waits for pending write and frees the writer
+void freeCheckpointWriter(CheckpointWriter *checkpoint);
+
+// Restores GA state and state of globalRng from checkpoint, NULL on failure
+// or if the checkpoint was written by another @engine
+GAState *readCheckpoint(const char *fileName, Engine engine);
+
+
+// Returns true if the model is linear in coefficients and errors are squared,
+// i.e. least squares gives the optimum directly
+bool isLinearProblem();
+
+// Computes sufficient statistics of all points of data set, false if
+// streamed points cannot be read
+bool datasetPolyStats(const Dataset *data, PolyStats *stats);
+
+// Solves symmetric positive definite system A x = b of size @n by Cholesky
+// decomposition, returns false if A is singular or @n exceeds MAX_GENOME_LEN
+bool choleskySolve(const double *A, const double *b, int n, double *x);
+
+// Solves normal equations given by statistics, false if they are singular
+bool solveNormalEquations(const PolyStats *stats, double *coefficients);
+
+// Computes coefficients minimizing sum of squared errors
+bool leastSquaresFit(const Dataset *data, float *coefficients);
+
+// Replaces the elite individual by least-squares solution if it is fitter,
+// returns true if the elite was replaced
+bool lamarckianRefinement(GAState *state, const Dataset *data);
+
+
+// Value of the model with coefficients @c at point @x
+double modelValue(const double *c, double x);
+
+// Derivatives of the polynomial with respect to coefficients at point @x,
+// they do not depend on coefficients, user model needs finite differences
+void modelGradient(double x, double *gradient);
+
+// Runs @steps Levenberg-Marquardt steps on @top fittest individuals,
+// individuals are replaced only if they get fitter. Needs points in memory.
+void localSearch(GAState *state, const Dataset *data, int top, int steps,
+                 Jacobian jacobian);
@@ -0,0 +1,224 @@
+/**
+
+Differential evolution engine.
+
+Every individual (target) competes with its own trial vector. Mutant is
+built from difference of random individuals:
+
+rand/1:             v = x_r1 + F*(x_r2 - x_r3)
+current-to-best/1:  v = x_i + F*(x_best - x_i) + F*(x_r1 - x_r2)
+
+and binomial crossover takes every gene from the mutant with probability CR
+(at least one gene always). Trial replaces the target if it is not worse.
+There is no global sort, every individual is handled independently, so trial
+generation and selection run in parallel across individuals. Each individual
+draws from its own generator seeded from globalRng, so results do not depend
+on the number of threads.
+
+With JADE adaptation F and CR of every individual are drawn around means,
+which move towards the values that produced successful trials.
+
+Population buffers, fitness kernels and convergence criteria are shared with
+the GA. The fittest individual is kept first in population.
+
+*/
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+
+#include "config.h"
+#include "cpu_version.h"
+
+using namespace std;
+
+// Learning rate of JADE means
+#define JADE_C 0.1
+
+// Picks random individual different from all of @exclude
+static int pickOther(Rng *rng, int size, const int *exclude, int nExclude)
+{
+    while(true){
+        int r = rngNext(rng) % size;
+        bool used = false;
+        for(int k=0; k<nExclude; k++)
+            used |= r == exclude[k];
+        if(!used)
+            return r;
+    }
+}
+
+// Moves the fittest individual to the front of population
+static void keepBestFirst(GAState *state)
+{
+    int best = 0;
+    for(int i=1; i<state->size; i++)
+        if(state->fitnesses[i] < state->fitnesses[best])
+            best = i;
+
+    if(best != 0){
+        for(int j=0; j<genomeLen; j++){
+            swap(state->population[j], state->population[best*genomeLen + j]);
+            swap(state->steps[j], state->steps[best*genomeLen + j]);
+        }
+        swap(state->fitnesses[0], state->fitnesses[best]);
+    }
+    state->bestFitness = state->fitnesses[0];
+}
+
+int runDifferentialEvolution(GAState *state, const Dataset *data, int generations,
+                             const Options *options)
+{
+    int size = state->size;
+    float target = fitnessTarget(data);
+    int done = 0;
+
+    //differential mutation needs 4 distinct individuals
+    if(size < 4)
+        return 0;
+
+    float *trialFitnesses = new float[size];
+    float *F = new float[size];
+    float *CR = new float[size];
+
+    //random and restarted individuals do not have fitness yet
+    bool unknown = false;
+    for(int i=0; i<size; i++)
+        unknown |= state->fitnesses[i] == INFINITY;
+    if(unknown){
+        if(evaluateUntil(data, state->population, size, state->fitnesses,
+                         options->deadline) == NULL){
+            //partial sums are not fitness, only the elite keeps its known value
+            for(int i=1; i<size; i++)
+                state->fitnesses[i] = INFINITY;
+            state->fitnesses[0] = state->bestFitness;
+            state->interrupted = !datasetFailed(data);
+            delete [] trialFitnesses;
+            delete [] F;
+            delete [] CR;
+            return 0;
+        }
+        state->evaluations += size;
+        keepBestFirst(state);
+    }
+
+    while ( (done < generations)
+            && (state->bestFitness > target)
+            && (state->noChangeIter < maxConstIter)
+            && !budgetExhausted(state, options) )
+    {
+        state->generationNumber++;
+        done++;
+        double t = omp_get_wtime();
+
+        unsigned long long base = ((unsigned long long)rngNext(&globalRng) << 32)
+                                  | rngNext(&globalRng);
+        float meanF = state->deMeanF;
+        float meanCR = state->deMeanCR;
+        const float *population = state->population;
+        float *trials = state->newPopulation;
+
+        /** mutation and crossover, trial vector for every individual */
+        #pragma omp parallel for schedule(static)
+        for(int i=0; i<size; i++)
+        {
+            Rng rng;
+            seedRng(&rng, base + i);
+
+            float f = de_F, cr = de_CR;
+            if(options->deAdaptive){
+                //F from Cauchy distribution, redrawn while not positive
+                do{
+                    f = meanF + 0.1*tan(M_PI*(rngUniform(&rng) - 0.5));
+                }while(f <= 0);
+                f = min(f, 1.0f);
+                cr = min(max(meanCR + 0.1f*rngNormal(&rng), 0.0f), 1.0f);
+            }
+            F[i] = f;
+            CR[i] = cr;
+
+            int r[4] = {i};
+            for(int k=1; k<4; k++)
+                r[k] = pickOther(&rng, size, r, k);
+
+            const float *x = &population[i*genomeLen];
+            const float *best = &population[0];
+            const float *x1 = &population[r[1]*genomeLen];
+            const float *x2 = &population[r[2]*genomeLen];
+            const float *x3 = &population[r[3]*genomeLen];
+            float *trial = &trials[i*genomeLen];
+
+            int forced = rngNext(&rng) % genomeLen;
+            for(int j=0; j<genomeLen; j++){
+                float mutant = options->deCurrentToBest
+                    ? x[j] + f*(best[j] - x[j]) + f*(x1[j] - x2[j])
+                    : x1[j] + f*(x2[j] - x3[j]);
+                trial[j] = (j == forced || rngUniform(&rng) < cr) ? mutant : x[j];
+            }
+        }
+        t = lapPhase(state, PHASE_MUTATION, t);
+
+        /** evaluate fitness of trial vectors */
+        if(evaluateUntil(data, trials, size, trialFitnesses, options->deadline) == NULL){
+            //generation is abandoned, population is untouched
+            state->generationNumber--;
+            done--;
+            state->interrupted = !datasetFailed(data);
+            lapPhase(state, PHASE_EVALUATION, t);
+            break;
+        }
+        state->evaluations += size;
+        t = lapPhase(state, PHASE_EVALUATION, t);
+
+        /** one-to-one selection, trial replaces target if it is not worse */
+        double sumCR = 0, sumF = 0, sumF2 = 0;
+        int successes = 0;
+
+        //only strictly better trials tell which parameters work, summed in
+        //fixed order, so the means do not depend on the number of threads
+        for(int i=0; i<size; i++)
+            if(trialFitnesses[i] < state->fitnesses[i]){
+                successes++;
+                sumCR += CR[i];
+                sumF += F[i];
+                sumF2 += F[i]*F[i];
+            }
+
+        #pragma omp parallel for schedule(static)
+        for(int i=0; i<size; i++)
+        {
+            if(!(trialFitnesses[i] <= state->fitnesses[i]))
+                continue;
+
+            for(int j=0; j<genomeLen; j++)
+                state->population[i*genomeLen + j] = trials[i*genomeLen + j];
+            state->fitnesses[i] = trialFitnesses[i];
+        }
+
+        //arithmetic mean of CR, Lehmer mean of F favours larger steps
+        if(options->deAdaptive && successes > 0){
+            state->deMeanCR = (1 - JADE_C)*state->deMeanCR + JADE_C*sumCR/successes;
+            state->deMeanF = (1 - JADE_C)*state->deMeanF + JADE_C*sumF2/sumF;
+        }
+
+        keepBestFirst(state);
+        trackConvergence(state, data);
+        t = lapPhase(state, PHASE_SELECTION, t);
+
+        refinePopulation(state, data, options);
+        lapPhase(state, PHASE_REFINEMENT, t);
+
+        //log message
+        #if defined(DEBUG)
+        cout << "#" << state->generationNumber<< " Fitness: " << state->bestFitness << \
+        " F: " << state->deMeanF << " CR: " << state->deMeanCR << endl;
+        #endif
+    }
+
+    delete [] trialFitnesses;
+    delete [] F;
+    delete [] CR;
+
+    return done;
+}
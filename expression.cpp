@@ -0,0 +1,517 @@
+/**
+
+Compiler and interpreter of user model expressions.
+
+Expression is parsed by recursive descent into a tree, constant subtrees are
+folded while the tree is built. Tree is then compiled into register-based
+bytecode: node compiled into register r leaves its operands in r and r+1,
+so the number of registers is given by the depth of the tree.
+
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+
+#include "config.h"
+#include "cpu_version.h"
+#include "expression.h"
+#include "loss.h"
+
+using namespace std;
+
+struct Node
+{
+    Opcode op;
+    int a, b;           // child nodes
+    int param;
+    double value;
+};
+
+struct Parser
+{
+    const char *text;
+    const char *pos;
+    Node nodes[EXPRESSION_MAX_CODE];
+    int nNodes;
+    int nParams;
+    const char *error;  // first error, NULL if none
+};
+
+static double applyOp(Opcode op, double a, double b)
+{
+    switch(op){
+        case OP_ADD:  return a + b;
+        case OP_SUB:  return a - b;
+        case OP_MUL:  return a * b;
+        case OP_DIV:  return a / b;
+        case OP_POW:  return pow(a, b);
+        case OP_NEG:  return -a;
+        case OP_EXP:  return exp(a);
+        case OP_LOG:  return log(a);
+        case OP_SIN:  return sin(a);
+        case OP_COS:  return cos(a);
+        case OP_TAN:  return tan(a);
+        case OP_TANH: return tanh(a);
+        case OP_SQRT: return sqrt(a);
+        case OP_ABS:  return fabs(a);
+        default:      return 0;
+    }
+}
+
+static bool isUnary(Opcode op)
+{
+    return op >= OP_NEG;
+}
+
+static int fail(Parser *p, const char *message)
+{
+    if(p->error == NULL)
+        p->error = message;
+    return -1;
+}
+
+// Largest integer exponent computed by multiplication
+#define MAX_POWI 16
+
+// Adds node to the tree, operations on constants are folded
+static int makeNode(Parser *p, Opcode op, int a, int b, int param, double value)
+{
+    if(p->nNodes == EXPRESSION_MAX_CODE)
+        return fail(p, "expression is too long");
+
+    //x^3 is common in models, pow() does not vectorize
+    if(op == OP_POW && p->nodes[a].op != OP_CONST && p->nodes[b].op == OP_CONST){
+        double exponent = p->nodes[b].value;
+        if(exponent == floor(exponent) && fabs(exponent) <= MAX_POWI){
+            op = OP_POWI;
+            param = (int)exponent;
+        }
+    }
+
+    bool constant = op >= OP_ADD && p->nodes[a].op == OP_CONST
+                    && (isUnary(op) || p->nodes[b].op == OP_CONST);
+    if(constant){
+        value = applyOp(op, p->nodes[a].value, isUnary(op) ? 0 : p->nodes[b].value);
+        op = OP_CONST;
+    }
+
+    Node node = {op, a, b, param, value};
+    p->nodes[p->nNodes] = node;
+    return p->nNodes++;
+}
+
+static void skipSpaces(Parser *p)
+{
+    while(isspace((unsigned char)*p->pos))
+        p->pos++;
+}
+
+static int parseExpr(Parser *p);
+static int parseUnary(Parser *p);
+
+static int parsePrimary(Parser *p)
+{
+    skipSpaces(p);
+    const char *start = p->pos;
+
+    if(*p->pos == '('){
+        p->pos++;
+        int node = parseExpr(p);
+        skipSpaces(p);
+        if(node < 0 || *p->pos != ')')
+            return fail(p, "missing ')'");
+        p->pos++;
+        return node;
+    }
+
+    if(isdigit((unsigned char)*p->pos) || *p->pos == '.'){
+        char *end;
+        double value = strtod(p->pos, &end);
+        p->pos = end;
+        return makeNode(p, OP_CONST, -1, -1, 0, value);
+    }
+
+    if(!isalpha((unsigned char)*p->pos))
+        return fail(p, "unexpected character");
+
+    while(isalnum((unsigned char)*p->pos) || *p->pos == '_')
+        p->pos++;
+    int len = p->pos - start;
+
+    if(len == 1 && *start == 'x')
+        return makeNode(p, OP_X, -1, -1, 0, 0);
+    if(len == 2 && strncmp(start, "pi", 2) == 0)
+        return makeNode(p, OP_CONST, -1, -1, 0, M_PI);
+
+    //coefficient c0, c1, ...
+    if(*start == 'c' && len > 1 && isdigit((unsigned char)start[1])){
+        int param = 0;
+        for(int k=1; k<len; k++){
+            if(!isdigit((unsigned char)start[k]))
+                return fail(p, "unknown identifier");
+            param = param*10 + (start[k] - '0');
+            if(param >= MAX_GENOME_LEN)
+                return fail(p, "coefficient index exceeds MAX_GENOME_LEN");
+        }
+        p->nParams = max(p->nParams, param + 1);
+        return makeNode(p, OP_PARAM, -1, -1, param, 0);
+    }
+
+    static const struct { const char *name; Opcode op; } functions[] = {
+        {"exp", OP_EXP}, {"log", OP_LOG}, {"sin", OP_SIN}, {"cos", OP_COS},
+        {"tan", OP_TAN}, {"tanh", OP_TANH}, {"sqrt", OP_SQRT}, {"abs", OP_ABS}};
+
+    for(unsigned f=0; f<sizeof(functions)/sizeof(functions[0]); f++){
+        if((int)strlen(functions[f].name) != len || strncmp(start, functions[f].name, len) != 0)
+            continue;
+
+        skipSpaces(p);
+        if(*p->pos != '(')
+            return fail(p, "missing '(' after function");
+        p->pos++;
+        int arg = parseExpr(p);
+        skipSpaces(p);
+        if(arg < 0 || *p->pos != ')')
+            return fail(p, "missing ')'");
+        p->pos++;
+        return makeNode(p, functions[f].op, arg, -1, 0, 0);
+    }
+
+    p->pos = start;
+    return fail(p, "unknown identifier");
+}
+
+static int parsePower(Parser *p)
+{
+    int base = parsePrimary(p);
+    if(base < 0)
+        return -1;
+
+    skipSpaces(p);
+    if(*p->pos != '^')
+        return base;
+    p->pos++;
+
+    //right associative, 2^-x is allowed
+    int exponent = parseUnary(p);
+    if(exponent < 0)
+        return -1;
+    return makeNode(p, OP_POW, base, exponent, 0, 0);
+}
+
+static int parseUnary(Parser *p)
+{
+    skipSpaces(p);
+    if(*p->pos == '-'){
+        p->pos++;
+        int a = parseUnary(p);
+        return a < 0 ? -1 : makeNode(p, OP_NEG, a, -1, 0, 0);
+    }
+    if(*p->pos == '+'){
+        p->pos++;
+        return parseUnary(p);
+    }
+    return parsePower(p);
+}
+
+static int parseTerm(Parser *p)
+{
+    int a = parseUnary(p);
+    while(a >= 0){
+        skipSpaces(p);
+        char c = *p->pos;
+        if(c != '*' && c != '/')
+            break;
+        p->pos++;
+        int b = parseUnary(p);
+        if(b < 0)
+            return -1;
+        a = makeNode(p, c == '*' ? OP_MUL : OP_DIV, a, b, 0, 0);
+    }
+    return a;
+}
+
+static int parseExpr(Parser *p)
+{
+    int a = parseTerm(p);
+    while(a >= 0){
+        skipSpaces(p);
+        char c = *p->pos;
+        if(c != '+' && c != '-')
+            break;
+        p->pos++;
+        int b = parseTerm(p);
+        if(b < 0)
+            return -1;
+        a = makeNode(p, c == '+' ? OP_ADD : OP_SUB, a, b, 0, 0);
+    }
+    return a;
+}
+
+// Compiles subtree @node so that its value ends in register @reg
+static bool emit(Expression *expression, const Node *nodes, int node, int reg)
+{
+    if(reg >= EXPRESSION_MAX_REGISTERS || expression->length == EXPRESSION_MAX_CODE)
+        return false;
+    expression->nRegisters = max(expression->nRegisters, reg + 1);
+
+    const Node *n = &nodes[node];
+    Instruction instruction = {n->op, reg, reg, reg + 1, n->param, (float)n->value};
+
+    if(n->op >= OP_ADD){
+        if(!emit(expression, nodes, n->a, reg))
+            return false;
+        if(!isUnary(n->op) && !emit(expression, nodes, n->b, reg + 1))
+            return false;
+    }
+
+    expression->code[expression->length++] = instruction;
+    return true;
+}
+
+Expression *compileExpression(const char *text)
+{
+    Parser *p = new Parser;
+    p->text = text;
+    p->pos = text;
+    p->nNodes = 0;
+    p->nParams = 0;
+    p->error = NULL;
+
+    int root = parseExpr(p);
+    skipSpaces(p);
+    if(root >= 0 && *p->pos != '\0')
+        fail(p, "unexpected character");
+
+    Expression *expression = NULL;
+    if(p->error == NULL){
+        expression = new Expression;
+        expression->length = 0;
+        expression->nRegisters = 0;
+        expression->nParams = p->nParams;
+        if(!emit(expression, p->nodes, root, 0)){
+            fail(p, "expression is too complex");
+            delete expression;
+            expression = NULL;
+        }
+    }
+
+    if(p->error != NULL)
+        cerr << "Error in model expression at position " << (p->pos - text) << ": "
+             << p->error << "!!!" << endl;
+
+    delete p;
+    return expression;
+}
+
+void freeExpression(Expression *expression)
+{
+    delete expression;
+}
+
+double evaluateExpression(const Expression *expression, const double *c, double x)
+{
+    double reg[EXPRESSION_MAX_REGISTERS];
+
+    for(int k=0; k<expression->length; k++){
+        const Instruction *in = &expression->code[k];
+        switch(in->op){
+            case OP_X:     reg[in->dst] = x; break;
+            case OP_PARAM: reg[in->dst] = c[in->param]; break;
+            case OP_CONST: reg[in->dst] = in->value; break;
+            case OP_POWI:  reg[in->dst] = pow(reg[in->a], in->param); break;
+            default:       reg[in->dst] = applyOp(in->op, reg[in->a], reg[in->b]); break;
+        }
+    }
+
+    return reg[0];
+}
+
+/**
+    Runs bytecode over block of @n points for @tile individuals with
+    coefficients @c, every instruction is one loop over the rows of all
+    individuals, row of individual t in register r starts at reg[r][t*n]
+*/
+static void runBlock(const Expression *expression, const float *c, int tile,
+                     const float *x, int n,
+                     float reg[][EXPRESSION_TILE*EXPRESSION_BLOCK])
+{
+    int m = tile*n;
+
+    for(int k=0; k<expression->length; k++){
+        const Instruction *in = &expression->code[k];
+        float *d = reg[in->dst];
+        const float *a = reg[in->a];
+        const float *b = reg[in->b];
+
+        switch(in->op){
+            case OP_X:
+                for(int t=0; t<tile; t++){
+                    #pragma omp simd
+                    for(int pt=0; pt<n; pt++) d[t*n + pt] = x[pt];
+                }
+                break;
+            case OP_PARAM:
+                for(int t=0; t<tile; t++){
+                    float v = c[t*genomeLen + in->param];
+                    #pragma omp simd
+                    for(int pt=0; pt<n; pt++) d[t*n + pt] = v;
+                }
+                break;
+            case OP_CONST: {
+                float v = in->value;
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = v;
+                break;
+            }
+            case OP_ADD:
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = a[pt] + b[pt];
+                break;
+            case OP_SUB:
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = a[pt] - b[pt];
+                break;
+            case OP_MUL:
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = a[pt] * b[pt];
+                break;
+            case OP_DIV:
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = a[pt] / b[pt];
+                break;
+            case OP_POW:
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = pow(a[pt], b[pt]);
+                break;
+            case OP_NEG:
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = -a[pt];
+                break;
+            case OP_EXP:
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = exp(a[pt]);
+                break;
+            case OP_LOG:
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = log(a[pt]);
+                break;
+            case OP_SIN:
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = sin(a[pt]);
+                break;
+            case OP_COS:
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = cos(a[pt]);
+                break;
+            case OP_TAN:
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = tan(a[pt]);
+                break;
+            case OP_TANH:
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = tanh(a[pt]);
+                break;
+            case OP_SQRT:
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = sqrt(a[pt]);
+                break;
+            case OP_ABS:
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++) d[pt] = fabs(a[pt]);
+                break;
+            case OP_POWI: {
+                int exponent = abs(in->param);
+                #pragma omp simd
+                for(int pt=0; pt<m; pt++){
+                    float power = 1;
+                    for(int k=0; k<exponent; k++)
+                        power *= a[pt];
+                    d[pt] = in->param < 0 ? 1/power : power;
+                }
+                break;
+            }
+        }
+    }
+}
+
+template <class Loss>
+static bool expressionChunk(const Loss &loss, const Expression *expression,
+                            const float *individuals, int size,
+                            const float *x, const float *y, const float *w, int count,
+                            float *fitnesses, double deadline)
+{
+    int nTiles = (size + EXPRESSION_TILE - 1)/EXPRESSION_TILE;
+    int checkEvery = max(1, 65536/max(count*EXPRESSION_TILE, 1));
+    bool expired = false;
+
+    #pragma omp parallel for schedule(static)
+    for(int tile=0; tile < nTiles; tile++)
+    {
+        bool skip;
+        if(deadline > 0 && tile % checkEvery == 0 && omp_get_wtime() >= deadline){
+            #pragma omp atomic write
+            expired = true;
+        }
+        #pragma omp atomic read
+        skip = expired;
+        if(skip)
+            continue;
+
+        int first = tile*EXPRESSION_TILE;
+        int tileSize = min(EXPRESSION_TILE, size - first);
+        float reg[EXPRESSION_MAX_REGISTERS][EXPRESSION_TILE*EXPRESSION_BLOCK];
+        float sumErrors[EXPRESSION_TILE] = {0};
+
+        for(int start=0; start<count; start+=EXPRESSION_BLOCK)
+        {
+            int n = min(EXPRESSION_BLOCK, count - start);
+            runBlock(expression, &individuals[first*genomeLen], tileSize, &x[start], n, reg);
+
+            for(int t=0; t<tileSize; t++){
+                const float *f = &reg[0][t*n];
+                float sumError = 0;
+                #pragma omp simd reduction(+:sumError)
+                for(int pt=0; pt<n; pt++){
+                    float diff = f[pt] - y[start + pt];
+                    sumError += Loss::weighted ? w[start + pt]*loss(diff) : loss(diff);
+                }
+                sumErrors[t] += sumError;
+            }
+        }
+
+        for(int t=0; t<tileSize; t++)
+            fitnesses[first + t] += sumErrors[t];
+    }
+
+    return !expired;
+}
+
+bool expressionFitnessChunk(const Expression *expression,
+                            const float *individuals, int size,
+                            const float *x, const float *y, const float *w, int count,
+                            float *fitnesses, double deadline)
+{
+    switch(lossFunction){
+        case LOSS_ABSOLUTE:
+            return expressionChunk(AbsoluteLoss(), expression, individuals, size,
+                                   x, y, w, count, fitnesses, deadline);
+        case LOSS_HUBER:
+            return expressionChunk(HuberLoss(lossScale), expression, individuals, size,
+                                   x, y, w, count, fitnesses, deadline);
+        case LOSS_CAUCHY:
+            return expressionChunk(CauchyLoss(lossScale), expression, individuals, size,
+                                   x, y, w, count, fitnesses, deadline);
+        case LOSS_WEIGHTED:
+            return expressionChunk(WeightedSquaredLoss(), expression, individuals, size,
+                                   x, y, w, count, fitnesses, deadline);
+        default:
+            return expressionChunk(SquaredLoss(), expression, individuals, size,
+                                   x, y, w, count, fitnesses, deadline);
+    }
+}
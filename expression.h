@@ -0,0 +1,70 @@
+/**
+    User model given as an expression in coefficients c0, c1, ... and x
+
+    Expression is parsed once into register-based bytecode. Subexpressions
+    not depending on x or coefficients are folded into constants. Bytecode
+    is interpreted over blocks of points, every instruction processes the
+    whole block in one vectorizable loop, so decoding of instructions is
+    amortized across the block.
+
+    Grammar:
+        expr    := term (('+' | '-') term)*
+        term    := unary (('*' | '/') unary)*
+        unary   := '-' unary | power
+        power   := primary ('^' unary)?
+        primary := number | 'x' | 'c'index | 'pi' | function '(' expr ')' | '(' expr ')'
+        function: exp log sin cos tan tanh sqrt abs
+*/
+
+// Points of one block processed by every instruction
+#define EXPRESSION_BLOCK 64
+
+// Individuals whose blocks are processed by every instruction together
+#define EXPRESSION_TILE 4
+
+// Maximum number of registers and instructions of compiled expression
+#define EXPRESSION_MAX_REGISTERS 32
+#define EXPRESSION_MAX_CODE 256
+
+enum Opcode
+{
+    OP_X,           // r = x
+    OP_PARAM,       // r = c[param]
+    OP_CONST,       // r = value
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_POW,     // r = a op b
+    OP_NEG, OP_EXP, OP_LOG, OP_SIN, OP_COS,     // r = op a
+    OP_TAN, OP_TANH, OP_SQRT, OP_ABS,
+    OP_POWI         // r = a^param, small integer power by multiplication
+};
+
+struct Instruction
+{
+    Opcode op;
+    int dst;        // destination register
+    int a, b;       // source registers
+    int param;      // coefficient index of OP_PARAM, exponent of OP_POWI
+    float value;    // constant of OP_CONST
+};
+
+struct Expression
+{
+    Instruction code[EXPRESSION_MAX_CODE];
+    int length;         // number of instructions, result is in register 0
+    int nRegisters;
+    int nParams;        // highest coefficient index + 1
+};
+
+// Compiles expression, returns NULL and reports error if it is invalid
+Expression *compileExpression(const char *text);
+
+void freeExpression(Expression *expression);
+
+// Value of expression with coefficients @c at point @x, in double
+double evaluateExpression(const Expression *expression, const double *c, double x);
+
+// Adds loss of @size individuals over @count points with weights @w to
+// @fitnesses, returns false if @deadline passed and individuals were skipped
+bool expressionFitnessChunk(const Expression *expression,
+                            const float *individuals, int size,
+                            const float *x, const float *y, const float *w, int count,
+                            float *fitnesses, double deadline);
@@ -0,0 +1,94 @@
+/**
+
+Fitness memoization.
+
+Crossover of equal parents and children that escape mutation reproduce
+genomes evaluated before. Their fitness is found in a table indexed by hash
+of the genome bits instead of evaluating them again on all points, which
+pays off for expensive models and large data sets.
+
+Table is direct-mapped and every slot holds the whole 64-bit hash, so
+genomes that share the slot index are told apart. Slot is two words, the
+value with a valid bit and the fitness bits, and the hash xored with the
+value. Threads read and write the words with plain atomic accesses; a slot
+torn by concurrent writes fails the xor check and misses, empty slot has
+no valid bit and never matches.
+
+*/
+
+#include <iostream>
+#include <cstring>
+
+#include "config.h"
+#include "cpu_version.h"
+
+using namespace std;
+
+FitnessCache *createFitnessCache(long long entries)
+{
+    long long slots = 1;
+    while(slots < entries)
+        slots *= 2;
+
+    FitnessCache *cache = new FitnessCache;
+    cache->slots = new unsigned long long[2*slots];
+    memset(cache->slots, 0, 2*slots*sizeof(unsigned long long));
+    cache->mask = slots - 1;
+    cache->lookups = 0;
+    cache->hits = 0;
+    return cache;
+}
+
+void freeFitnessCache(FitnessCache *cache)
+{
+    delete [] cache->slots;
+    delete cache;
+}
+
+unsigned long long genomeHash(const float *genome)
+{
+    unsigned long long h = 0x9E3779B97F4A7C15ULL;
+    for(int j=0; j<genomeLen; j++){
+        unsigned int bits;
+        memcpy(&bits, &genome[j], sizeof(bits));
+        h = (h ^ bits)*0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 31;
+    }
+    //splitmix64 finalizer spreads bits over both halves
+    h = (h ^ (h >> 30))*0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27))*0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+// Occupancy of slot, kept apart from the fitness bits in the value word
+#define SLOT_VALID (1ULL << 32)
+
+bool cacheLookup(const FitnessCache *cache, unsigned long long hash, float *fitness)
+{
+    unsigned long long check, value;
+    const unsigned long long *address = &cache->slots[2*(hash & cache->mask)];
+    #pragma omp atomic read
+    check = address[0];
+    #pragma omp atomic read
+    value = address[1];
+
+    if(!(value & SLOT_VALID) || (check ^ value) != hash)
+        return false;
+
+    unsigned int bits = (unsigned int)value;
+    memcpy(fitness, &bits, sizeof(bits));
+    return true;
+}
+
+void cacheStore(FitnessCache *cache, unsigned long long hash, float fitness)
+{
+    unsigned int bits;
+    memcpy(&bits, &fitness, sizeof(bits));
+    unsigned long long value = SLOT_VALID | bits;
+
+    unsigned long long *address = &cache->slots[2*(hash & cache->mask)];
+    #pragma omp atomic write
+    address[0] = hash ^ value;
+    #pragma omp atomic write
+    address[1] = value;
+}
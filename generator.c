@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 float c3 = -2.;
 float c2 = 4.;
@@ -19,26 +20,38 @@ float poly(float x)
 
 int main(int argc, char **argv)
 {
-	if (argc != 2)
+	if (argc != 2 && argc != 3)
 	{
-		printf("Usage: %s <N>\n", argv[0]);
+		printf("Usage: %s <N> [output.txt|output.bin]\n", argv[0]);
 		exit(1);
 	}
 
-    int N = atoi(argv[1]);
-    
-    FILE *f = fopen("input.txt","w");
+    long long N = atoll(argv[1]);
+    const char *name = argc == 3 ? argv[2] : "input.txt";
+
+    //files with .bin extension hold (x, f(x)) pairs as raw floats
+    size_t len = strlen(name);
+    int binary = len > 4 && strcmp(name + len - 4, ".bin") == 0;
+
+    FILE *f = fopen(name, binary ? "wb" : "w");
     if (!f) return -1;
 
-    float x = -1.0;
-    for (int i = 0; i < 100; i++)
+    //points are spread over interval (-1, 2>, x is computed from the index,
+    //so rounding does not accumulate even for billions of points
+    for (long long i = 0; i < N; i++)
     {
-        x += 0.03;
-        fprintf(f, "%f %f\n", x, poly((x)) + noise());
+        float x = (float)(-1.0 + 3.0 * (i + 1) / N);
+        float y = poly((x)) + noise();
+        if (binary)
+        {
+            float pair[2] = {x, y};
+            fwrite(pair, sizeof(float), 2, f);
+        }
+        else
+            fprintf(f, "%f %f\n", x, y);
     }    
 
     fclose(f);
 
     return 0;
 }
-
@@ -45,6 +45,9 @@ using namespace std;
 // polynomial function using GA.
 static float *readData(const char *name, const int POINTS_CNT);
 
+// Reads known solutions, INDIVIDUAL_LEN coefficients per line
+static float *readSeeds(const char *name, int *nSeeds);
+
 // Gets last error and prints message when error is present
 static void check_cuda_error(const char *message);
 
@@ -251,6 +254,36 @@ __global__ void initPopulation(float *population, curandState *state)
     state[idx] = localState;
 }
 
+/**
+    Initializes initial population from known solutions, e.g. previous fit.
+
+    Every seed is kept once unchanged at the beginning of population, other
+    individuals from first @nSeeded are seeds perturbed by normal noise with
+    stddev @perturbation, rest of population is random <-5.0, 5.0> for diversity.
+*/
+__global__ void seedPopulation(float *population, curandState *state,
+                               float *seeds, int nSeeds, int nSeeded,
+                               float perturbation)
+{
+    int idx = blockDim.x * blockIdx.x + threadIdx.x;
+    if (idx >= POPULATION_SIZE) return;
+
+    curandState localState = state[idx];
+    float *seed = &seeds[(idx % nSeeds) * INDIVIDUAL_LEN];
+
+    for (int i = 0; i < INDIVIDUAL_LEN; i++)
+    {
+        if (idx < nSeeds)
+            population[idx * INDIVIDUAL_LEN + i] = seed[i];
+        else if (idx < nSeeded)
+            population[idx * INDIVIDUAL_LEN + i] = seed[i] + perturbation * curand_normal(&localState);
+        else
+            population[idx * INDIVIDUAL_LEN + i] = 10 * curand_uniform(&localState) - 5;
+    }
+
+    state[idx] = localState;
+}
+
 //------------------------------------------------------------------------------
 
 
@@ -261,9 +294,9 @@ __global__ void initPopulation(float *population, curandState *state)
 */
 int main(int argc, char **argv)
 {
-    if (argc != 2)
+    if (argc != 2 && argc != 3)
     {
-        cout << "Usage: " << argv[0] << " inputFile" << endl;    
+        cout << "Usage: " << argv[0] << " inputFile [seedFile]" << endl;    
         return -1;
     }
 
@@ -330,7 +363,30 @@ int main(int argc, char **argv)
 
     //Initialize first population (with zeros or some random values)
     initCurand<<<BLOCK, THREAD>>>(state_random);
-    initPopulation<<<BLOCK, THREAD>>>(population_dev, state_random); //<-5, 5>
+    if (argc == 3)
+    {
+        //warm start from known solutions
+        int nSeeds;
+        float *seeds = readSeeds(argv[2], &nSeeds);
+        int nSeeded = max(POPULATION_SIZE - (int)(seed_random_fraction * POPULATION_SIZE),
+                          min(nSeeds, POPULATION_SIZE));
+
+        float *seeds_dev;
+        cudaMalloc(&seeds_dev, nSeeds * INDIVIDUAL_LEN * sizeof(float));
+        check_cuda_error("Error allocating device memory");
+        cudaMemcpy(seeds_dev, seeds, nSeeds * INDIVIDUAL_LEN * sizeof(float), cudaMemcpyHostToDevice);
+        check_cuda_error("Error copying data");
+
+        seedPopulation<<<BLOCK, THREAD>>>(population_dev, state_random,
+                                          seeds_dev, nSeeds, nSeeded, seed_perturbation);
+        cudaDeviceSynchronize();
+        check_cuda_error("Seeding population");
+
+        cudaFree(seeds_dev);
+        delete [] seeds;
+    }
+    else
+        initPopulation<<<BLOCK, THREAD>>>(population_dev, state_random); //<-5, 5>
 
     /**
         Main GA loop
@@ -467,6 +523,36 @@ static float *readData(const char *name, const int POINTS_CNT)
     return points;
 }
 
+static float *readSeeds(const char *name, int *nSeeds)
+{
+    FILE *file = fopen(name, "r");
+    if (!file)
+    {
+        cerr << "Error while opening the file " << name << "!!!" << endl;
+        exit(1);
+    }
+
+    //count solutions first, c0 c1 ... on each line
+    int count = 0;
+    float value;
+    while (fscanf(file, "%f", &value) == 1)
+        count++;
+    if (count < INDIVIDUAL_LEN)
+    {
+        cerr << "No solution found in the file " << name << endl;
+        exit(1);
+    }
+
+    *nSeeds = count / INDIVIDUAL_LEN;
+    float *seeds = new float[*nSeeds * INDIVIDUAL_LEN];
+    rewind(file);
+    for (int k = 0; k < *nSeeds * INDIVIDUAL_LEN; k++)
+        fscanf(file, "%f", &seeds[k]);
+    fclose(file);
+
+    return seeds;
+}
+
 static void check_cuda_error(const char *message)
 {
 	cudaError_t err = cudaGetLastError();
@@ -0,0 +1,139 @@
+/**
+
+Closed-form least-squares solution for models linear in their coefficients.
+
+Polynomial model is linear in coefficients, so the minimum of sum of squared
+errors solves normal equations A c = b, where A_jk = sum x^(j+k) and
+b_j = sum y x^j are the sufficient statistics of the points. The system is
+tiny (INDIVIDUAL_LEN^2) and is solved by Cholesky decomposition in double.
+
+The solution either answers the problem directly, or is written into the
+elite individual every few generations of the GA (Lamarckian refinement).
+It is also the reference optimum the GA result is compared with.
+
+*/
+
+#include <iostream>
+#include <cmath>
+
+#include "config.h"
+#include "cpu_version.h"
+#include "surface.h"
+
+using namespace std;
+
+bool isLinearProblem()
+{
+    //normal equations are built for the polynomial and (weighted) squared
+    //errors only, user model is treated as nonlinear even if it is not
+    return userModel == NULL
+           && (lossFunction == LOSS_SQUARED || lossFunction == LOSS_WEIGHTED);
+}
+
+bool datasetPolyStats(const Dataset *data, PolyStats *stats)
+{
+    if(data->stats != NULL){
+        *stats = *data->stats;
+        return true;
+    }
+
+    if(data->stream != NULL)
+        return streamPolyStats(data->stream, stats);
+
+    clearPolyStats(stats);
+    for(long long pt=0; pt<data->nPoints; pt++)
+        addPolyStatsPoint(stats, data->points[pt], data->points[data->nPoints + pt],
+                          data->weights != NULL ? data->weights[pt] : 1);
+    return true;
+}
+
+bool choleskySolve(const double *A, const double *b, int n, double *x)
+{
+    double L[MAX_GENOME_LEN*MAX_GENOME_LEN];
+    if(n > MAX_GENOME_LEN)
+        return false;
+
+    //A = L L^T
+    for(int j=0; j<n; j++){
+        for(int k=0; k<=j; k++){
+            double sum = A[j*n + k];
+            for(int m=0; m<k; m++)
+                sum -= L[j*n + m]*L[k*n + m];
+
+            if(j == k){
+                //matrix is singular or not positive definite
+                if(!(sum > 1e-12*fabs(A[0])))
+                    return false;
+                L[j*n + j] = sqrt(sum);
+            }else
+                L[j*n + k] = sum/L[k*n + k];
+        }
+    }
+
+    //forward substitution L z = b
+    double z[MAX_GENOME_LEN];
+    for(int j=0; j<n; j++){
+        double sum = b[j];
+        for(int m=0; m<j; m++)
+            sum -= L[j*n + m]*z[m];
+        z[j] = sum/L[j*n + j];
+    }
+
+    //back substitution L^T x = z
+    for(int j=n-1; j>=0; j--){
+        double sum = z[j];
+        for(int m=j+1; m<n; m++)
+            sum -= L[m*n + j]*x[m];
+        x[j] = sum/L[j*n + j];
+    }
+
+    return true;
+}
+
+bool solveNormalEquations(const PolyStats *stats, double *coefficients)
+{
+    //A_jk = xPow[j+k]
+    double A[INDIVIDUAL_LEN*INDIVIDUAL_LEN];
+    for(int j=0; j<INDIVIDUAL_LEN; j++)
+        for(int k=0; k<INDIVIDUAL_LEN; k++)
+            A[j*INDIVIDUAL_LEN + k] = stats->xPow[j+k];
+
+    return choleskySolve(A, stats->yxPow, INDIVIDUAL_LEN, coefficients);
+}
+
+bool leastSquaresFit(const Dataset *data, float *coefficients)
+{
+    if(data->surface != NULL)
+        return surfaceLeastSquares(data->surface, data->weights, coefficients);
+
+    PolyStats stats;
+    double c[INDIVIDUAL_LEN];
+    if(!datasetPolyStats(data, &stats) || !solveNormalEquations(&stats, c))
+        return false;
+
+    for(int j=0; j<INDIVIDUAL_LEN; j++)
+        coefficients[j] = c[j];
+    return true;
+}
+
+bool lamarckianRefinement(GAState *state, const Dataset *data)
+{
+    float refined[MAX_GENOME_LEN];
+    if(!isLinearProblem() || !leastSquaresFit(data, refined))
+        return false;
+
+    float refinedFitness;
+    evaluate(data, refined, 1, &refinedFitness);
+    state->evaluations++;
+
+    //refined genome is inherited only if it improves the elite
+    if(!(refinedFitness < state->fitnesses[0]))
+        return false;
+
+    for(int j=0; j<genomeLen; j++)
+        state->population[j] = refined[j];
+    state->fitnesses[0] = refinedFitness;
+    state->bestFitness = refinedFitness;
+
+    return true;
+}
@@ -0,0 +1,199 @@
+/**
+
+Levenberg-Marquardt local search on the fittest individuals.
+
+Near the optimum the GA moves by tiny mutations only. A few steps of
+Levenberg-Marquardt (damped Gauss-Newton) on the top individuals finish
+that phase in a handful of iterations. Residuals r = f(x) - model(c, x)
+are linearized by the Jacobian dmodel/dc, which is computed analytically
+for the polynomial model or by central finite differences, so the same
+step works for models that are not linear in coefficients.
+
+Step delta solves (J^T J + lambda diag(J^T J)) delta = J^T r. Damping
+lambda is decreased after a successful step and increased after a step
+that does not lower the sum of squared errors, which is then rejected.
+
+*/
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+#include "config.h"
+#include "cpu_version.h"
+#include "expression.h"
+
+using namespace std;
+
+double modelValue(const double *c, double x)
+{
+    if(userModel != NULL)
+        return evaluateExpression(userModel, c, x);
+
+    //Horner scheme, c0 + c1*x + c2*x^2 + ...
+    double value = 0;
+    for(int order=INDIVIDUAL_LEN-1; order>=0; order--)
+        value = value*x + c[order];
+    return value;
+}
+
+void modelGradient(double x, double *gradient)
+{
+    //model is linear in coefficients, d/dc_k = x^k
+    double x_order = 1.;
+    for(int order=0; order<INDIVIDUAL_LEN; order++){
+        gradient[order] = x_order;
+        x_order *= x;
+    }
+}
+
+// Central difference approximation of the gradient of the model
+static void finiteDifferenceGradient(const double *c, double x, double *gradient)
+{
+    double shifted[MAX_GENOME_LEN];
+    for(int j=0; j<genomeLen; j++)
+        shifted[j] = c[j];
+
+    for(int j=0; j<genomeLen; j++){
+        double h = 1e-6*(fabs(c[j]) + 1);
+        shifted[j] = c[j] + h;
+        double up = modelValue(shifted, x);
+        shifted[j] = c[j] - h;
+        double down = modelValue(shifted, x);
+        shifted[j] = c[j];
+        gradient[j] = (up - down)/(2*h);
+    }
+}
+
+// Sum of squared errors of coefficients @c on points in memory
+static double sumSquaredErrors(const double *c, const float *x, const float *y,
+                               long long nPoints)
+{
+    double sum = 0;
+    for(long long pt=0; pt<nPoints; pt++){
+        double diff = modelValue(c, x[pt]) - y[pt];
+        sum += diff*diff;
+    }
+    return sum;
+}
+
+/**
+    Runs at most @steps accepted or rejected steps from @individual,
+    the individual is overwritten by the improved coefficients
+*/
+static void levenbergMarquardt(float *individual, const float *x, const float *y,
+                               long long nPoints, int steps, Jacobian jacobian)
+{
+    const int L = genomeLen;
+    double c[MAX_GENOME_LEN];
+    for(int j=0; j<L; j++)
+        c[j] = individual[j];
+
+    double cost = sumSquaredErrors(c, x, y, nPoints);
+    double lambda = 1e-3;
+
+    for(int step=0; step<steps; step++)
+    {
+        //normal equations of linearized problem
+        double JTJ[MAX_GENOME_LEN*MAX_GENOME_LEN] = {0};
+        double JTr[MAX_GENOME_LEN] = {0};
+        double gradient[MAX_GENOME_LEN];
+        for(long long pt=0; pt<nPoints; pt++){
+            if(jacobian == JACOBIAN_ANALYTIC)
+                modelGradient(x[pt], gradient);
+            else
+                finiteDifferenceGradient(c, x[pt], gradient);
+
+            double r = y[pt] - modelValue(c, x[pt]);
+            for(int j=0; j<L; j++){
+                JTr[j] += gradient[j]*r;
+                for(int k=0; k<=j; k++)
+                    JTJ[j*L + k] += gradient[j]*gradient[k];
+            }
+        }
+        for(int j=0; j<L; j++)
+            for(int k=0; k<j; k++)
+                JTJ[k*L + j] = JTJ[j*L + k];
+
+        //damped step, scaled by diagonal so that it does not depend on units
+        double A[MAX_GENOME_LEN*MAX_GENOME_LEN];
+        for(int j=0; j<L*L; j++)
+            A[j] = JTJ[j];
+        for(int j=0; j<L; j++)
+            A[j*L + j] += lambda*max(JTJ[j*L + j], 1e-12);
+
+        double delta[MAX_GENOME_LEN];
+        double candidate[MAX_GENOME_LEN];
+        bool solved = choleskySolve(A, JTr, L, delta);
+        for(int j=0; j<L; j++)
+            candidate[j] = c[j] + (solved ? delta[j] : 0);
+
+        double candidateCost = solved ? sumSquaredErrors(candidate, x, y, nPoints) : INFINITY;
+        if(candidateCost < cost){
+            for(int j=0; j<L; j++)
+                c[j] = candidate[j];
+            cost = candidateCost;
+            lambda = max(lambda/10, 1e-12);
+        }else
+            lambda *= 10;
+    }
+
+    for(int j=0; j<L; j++)
+        individual[j] = c[j];
+}
+
+void localSearch(GAState *state, const Dataset *data, int top, int steps,
+                 Jacobian jacobian)
+{
+    //residuals of individual points are needed
+    if(data->points == NULL)
+        return;
+
+    top = min(top, state->size);
+    const float *x = data->points;
+    const float *y = data->points + data->nPoints;
+
+    //user model has no analytic gradient
+    if(userModel != NULL)
+        jacobian = JACOBIAN_FD;
+
+    float *refined = new float[top*genomeLen];
+    float *refinedFitnesses = new float[top];
+    for(int j=0; j<top*genomeLen; j++)
+        refined[j] = state->population[j];
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int i=0; i<top; i++)
+        levenbergMarquardt(&refined[i*genomeLen], x, y, data->nPoints,
+                           steps, jacobian);
+
+    //fitness is evaluated the same way as for the rest of population
+    evaluate(data, refined, top, refinedFitnesses);
+    state->evaluations += top;
+
+    //refined individual replaces the original one only if it is fitter
+    for(int i=0; i<top; i++){
+        if(!(refinedFitnesses[i] < state->fitnesses[i]))
+            continue;
+        for(int j=0; j<genomeLen; j++)
+            state->population[i*genomeLen + j] = refined[i*genomeLen + j];
+        state->fitnesses[i] = refinedFitnesses[i];
+    }
+
+    //keep the fittest individual first
+    int best = 0;
+    for(int i=1; i<top; i++)
+        if(state->fitnesses[i] < state->fitnesses[best])
+            best = i;
+    if(best != 0){
+        for(int j=0; j<genomeLen; j++){
+            swap(state->population[j], state->population[best*genomeLen + j]);
+            swap(state->steps[j], state->steps[best*genomeLen + j]);
+        }
+        swap(state->fitnesses[0], state->fitnesses[best]);
+    }
+    state->bestFitness = state->fitnesses[0];
+
+    delete [] refined;
+    delete [] refinedFitnesses;
+}
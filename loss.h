@@ -0,0 +1,103 @@
+/**
+    Loss policies of fitness kernels
+
+    Fitness is the sum of loss of residuals r = model - value over all points.
+    Kernels are templates instantiated for every policy, so the loss is
+    inlined into their vectorized loops without per-point call or branch.
+    Weighted policy multiplies loss of every point by its weight.
+    Losses are templates of the residual type, so kernels computing in
+    double (precision.h) keep double up to the sum.
+*/
+
+#include <cmath>
+#include <cstring>
+
+/**
+    Natural logarithm of positive normal @v, relative error about 1e-5,
+    which is below the rounding error of float sums over many points
+
+    logf() is a library call that stops vectorization of the kernels.
+    v = m * 2^e with m in [sqrt(1/2), sqrt(2)), log m = t + t^2 p(t) of
+    t = m - 1, p is minimax polynomial of degree 4 on the range of t. It is
+    evaluated by Estrin's scheme, the kernels are limited by the length of
+    the dependency chain of every point rather than by count of operations.
+*/
+static inline float fastLog(float v)
+{
+    int bits;
+    memcpy(&bits, &v, sizeof(bits));
+    //move exponent so that mantissa is centered around 1
+    int e = ((bits - 0x3F3504F3) >> 23);
+    bits -= e << 23;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+
+    float t = m - 1;
+    float t2 = t*t;
+    float p = (-0.499875082f + 0.332623611f*t) + t2*(-0.254588349f + 0.220707403f*t)
+              - t2*t2*0.141064359f;
+    return (t + e*0.693147181f) + t2*p;
+}
+
+// Double version of fastLog(), series is summed up to s^21
+static inline double fastLog(double v)
+{
+    long long bits;
+    memcpy(&bits, &v, sizeof(bits));
+    long long e = ((bits - 0x3FE6A09E667F3BCDLL) >> 52);
+    bits -= e << 52;
+    double m;
+    memcpy(&m, &bits, sizeof(m));
+
+    double s = (m - 1)/(m + 1);
+    double s2 = s*s;
+    double series = 2.0/21;
+    for(int k=9; k>=0; k--)
+        series = 2.0/(2*k + 1) + s2*series;
+    return s*series + e*0.69314718055994531;
+}
+
+struct SquaredLoss
+{
+    static const bool weighted = false;
+    template <class T> T operator()(T r) const { return r*r; }
+};
+
+struct AbsoluteLoss
+{
+    static const bool weighted = false;
+    template <class T> T operator()(T r) const { return fabs(r); }
+};
+
+// Quadratic for |r| <= delta, linear beyond it
+struct HuberLoss
+{
+    static const bool weighted = false;
+    float delta;
+    HuberLoss(float delta) : delta(delta) {}
+    template <class T> T operator()(T r) const
+    {
+        //branchless form of a <= delta ? a*a/2 : delta*(a - delta/2)
+        T a = fabs(r);
+        T q = a < delta ? a : (T)delta;
+        return q*(a - (T)0.5*q);
+    }
+};
+
+// Logarithmic growth, outliers have almost no influence
+struct CauchyLoss
+{
+    static const bool weighted = false;
+    float halfScale2, invScale2;
+    CauchyLoss(float scale) : halfScale2(0.5f*scale*scale), invScale2(1/(scale*scale)) {}
+    template <class T> T operator()(T r) const
+    {
+        return (T)halfScale2*fastLog(1 + r*r*(T)invScale2);
+    }
+};
+
+struct WeightedSquaredLoss
+{
+    static const bool weighted = true;
+    template <class T> T operator()(T r) const { return r*r; }
+};
@@ -28,11 +28,14 @@ Outputs:
 #include <cmath>
 #include <time.h>
 #include <algorithm>
+#include <string>
+#include <cstring>
 
 #include "nvToolsExt.h"
 #include "mpi_version_multi.h"
 
 #include "config.h"
+#include "checkpoint.h"
 
 using namespace std;
 
@@ -49,6 +52,40 @@ using namespace std;
 void generateMutProbab(float** mutIndivid, float **mutGene,
                        curandGenerator_t generator, int size);
 
+/**
+    Checkpoint written by all processes through MPI-IO. Each process writes
+    its own slice of the sorted population from host snapshot buffers using
+    nonblocking I/O, so computation continues while the file is written.
+*/
+struct MPICheckpoint
+{
+    const char *fileName;   // NULL if checkpoints are disabled
+    int every;              // generations between checkpoints
+    std::string tmpName;    // file being written, renamed when complete
+    MPI_File file;
+    MPI_Request requests[3];
+    int pending;            // number of outstanding requests
+    CheckpointHeader header;
+    float *population;      // local slice, individual after individual
+    float *fitnesses;
+    float *staging;         // local slice as copied from device, gene after gene
+};
+
+// Waits for outstanding checkpoint writes and publishes the checkpoint
+void finishCheckpoint(MPICheckpoint *checkpoint, int commRank);
+
+// Writes slices of sorted population of all processes into checkpoint
+void writeCheckpoint(MPICheckpoint *checkpoint, int commRank, int local_size,
+                     float *population_dev, float *population_dev_local,
+                     float *fitness_dev, int generationNumber, int noChangeIter,
+                     float bestFitness, float previousBestFitness);
+
+// Reads slices of population from checkpoint and gathers them on master
+bool readCheckpoint(const char *fileName, int commRank, int local_size,
+                    float *population_dev, float *population_dev_local,
+                    int *generationNumber, int *noChangeIter,
+                    float *bestFitness, float *previousBestFitness);
+
 /*
     ---------------------------------------------------------
     |  MPI communication and encapsulated GPU computation   |
@@ -56,8 +93,27 @@ void generateMutProbab(float** mutIndivid, float **mutGene,
 */
 int main(int argc, char **argv)
 {
-    if(argc != 2) {
-        cerr << "Usage: $mpirun -np N ./gpu inputFile" << endl;    
+    //checkpoint options follow input file
+    MPICheckpoint checkpoint;
+    checkpoint.fileName = NULL;
+    checkpoint.every = 100;
+    checkpoint.pending = 0;
+    const char *restartFile = NULL;
+    bool validArgs = argc >= 2;
+    for(int i=2; i<argc && validArgs; i++){
+        if(strcmp(argv[i], "--checkpoint") == 0 && i+1 < argc)
+            checkpoint.fileName = argv[++i];
+        else if(strcmp(argv[i], "--checkpoint-every") == 0 && i+1 < argc)
+            checkpoint.every = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--restart") == 0 && i+1 < argc)
+            restartFile = argv[++i];
+        else
+            validArgs = false;
+    }
+
+    if(!validArgs || checkpoint.every < 1) {
+        cerr << "Usage: $mpirun -np N ./gpu inputFile [--checkpoint file]"
+                " [--checkpoint-every n] [--restart file]" << endl;    
         return -1;
     }
 
@@ -212,6 +268,22 @@ int main(int argc, char **argv)
     float bestFitness = INFINITY;
     float previousBestFitness = INFINITY;
 
+    //host buffers for slices of population written to checkpoint
+    if(checkpoint.fileName != NULL){
+        checkpoint.population = new float[local_size * INDIVIDUAL_LEN];
+        checkpoint.fitnesses = new float[local_size];
+        checkpoint.staging = new float[local_size * INDIVIDUAL_LEN];
+    }
+
+    //continue with population from checkpoint
+    if(restartFile != NULL){
+        if(!readCheckpoint(restartFile, commRank, local_size,
+                           population_dev, population_dev_local,
+                           &generationNumber, &noChangeIter,
+                           &bestFitness, &previousBestFitness))
+            my_abort(-1);
+    }
+
 	while ( (generationNumber < maxGenerationNumber)
             /*&& (bestFitness > targetErr)
             && (noChangeIter < maxConstIter)*/ )
@@ -324,6 +396,16 @@ int main(int argc, char **argv)
             #endif
         }
 
+        /** periodically save sorted population, written in the background */
+        if(checkpoint.fileName != NULL
+           && (generationNumber % checkpoint.every == 0
+               || generationNumber == maxGenerationNumber)){
+            writeCheckpoint(&checkpoint, commRank, local_size,
+                            population_dev, population_dev_local, fitness_dev,
+                            generationNumber, noChangeIter,
+                            bestFitness, previousBestFitness);
+        }
+
 	}
 
     int t2 = clock(); //stop timer
@@ -398,6 +480,13 @@ int main(int argc, char **argv)
     curandDestroyGenerator(generator);
     check_cuda_error("Destroying generator");
 
+    if(checkpoint.fileName != NULL){
+        finishCheckpoint(&checkpoint, commRank);
+        delete [] checkpoint.population;
+        delete [] checkpoint.fitnesses;
+        delete [] checkpoint.staging;
+    }
+
     MPI_CHECK(MPI_Type_free(&columntype));
 
     MPI_CHECK(MPI_Finalize());
@@ -447,6 +536,169 @@ void generateMutProbab(float** mutIndivid, float **mutGene, curandGenerator_t ge
     check_cuda_error("Error in normalGenerating 2");
 }
 
+void finishCheckpoint(MPICheckpoint *checkpoint, int commRank)
+{
+    if(checkpoint->pending == 0)
+        return;
+
+    MPI_CHECK(MPI_Waitall(checkpoint->pending, checkpoint->requests, MPI_STATUSES_IGNORE));
+    MPI_CHECK(MPI_File_close(&checkpoint->file));
+    checkpoint->pending = 0;
+
+    //replace previous checkpoint only when all slices are written
+    MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
+    if(commRank == 0
+       && rename(checkpoint->tmpName.c_str(), checkpoint->fileName) != 0)
+        cerr << "Error while writing checkpoint " << checkpoint->fileName << "!!!" << endl;
+}
+
+void writeCheckpoint(MPICheckpoint *checkpoint, int commRank, int local_size,
+                     float *population_dev, float *population_dev_local,
+                     float *fitness_dev, int generationNumber, int noChangeIter,
+                     float bestFitness, float previousBestFitness)
+{
+    //snapshot buffers are still used by the previous checkpoint
+    finishCheckpoint(checkpoint, commRank);
+
+    //distribute sorted population and fitnesses, gene after gene
+    for(int i=0; i<INDIVIDUAL_LEN; i++){
+        MPI_CHECK(
+            MPI_Scatter(
+                &population_dev[i*POPULATION_SIZE], local_size, MPI_FLOAT,
+                &population_dev_local[i*local_size], local_size, MPI_FLOAT,
+                0, MPI_COMM_WORLD)
+        );
+    }
+    MPI_CHECK(
+        MPI_Scatter(fitness_dev, local_size, MPI_FLOAT,
+                    commRank == 0 ? MPI_IN_PLACE : fitness_dev, local_size, MPI_FLOAT,
+                    0, MPI_COMM_WORLD)
+    );
+
+    //snapshot of local slice, individuals are stored one after another in file
+    cudaMemcpy(checkpoint->staging, population_dev_local,
+               local_size*INDIVIDUAL_LEN*sizeof(float), cudaMemcpyDeviceToHost);
+    check_cuda_error("Copying population slice to host");
+    cudaMemcpy(checkpoint->fitnesses, fitness_dev,
+               local_size*sizeof(float), cudaMemcpyDeviceToHost);
+    check_cuda_error("Copying fitness slice to host");
+
+    for(int k=0; k<local_size; k++)
+        for(int i=0; i<INDIVIDUAL_LEN; i++)
+            checkpoint->population[k*INDIVIDUAL_LEN + i] = checkpoint->staging[i*local_size + k];
+
+    CheckpointHeader *header = &checkpoint->header;
+    header->magic = CHECKPOINT_MAGIC;
+    header->version = CHECKPOINT_VERSION;
+    header->engine = CHECKPOINT_ENGINE_GA;
+    header->populationSize = POPULATION_SIZE;
+    header->individualLen = INDIVIDUAL_LEN;
+    header->generationNumber = generationNumber;
+    header->noChangeIter = noChangeIter;
+    header->bestFitness = bestFitness;
+    header->previousBestFitness = previousBestFitness;
+    header->rngState = 0; //state of curand generators is not stored
+    header->evaluations = (long long)generationNumber*POPULATION_SIZE;
+    header->duplicates = 0;
+    for(int p=0; p<CHECKPOINT_PHASES; p++)
+        header->phaseTimes[p] = 0;  //phases are not timed
+    header->restarts = 0;
+    header->mutationScale = initial_mutation_step;
+    header->deMeanF = de_F;
+    header->deMeanCR = de_CR;
+    header->stepsStored = 0;
+    header->cmaBytes = 0;
+    header->psoBytes = 0;
+
+    checkpoint->tmpName = std::string(checkpoint->fileName) + ".tmp";
+    MPI_CHECK(MPI_File_open(MPI_COMM_WORLD, (char *)checkpoint->tmpName.c_str(),
+                            MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                            MPI_INFO_NULL, &checkpoint->file));
+
+    int first = commRank*local_size;
+    MPI_CHECK(MPI_File_iwrite_at(checkpoint->file,
+                                 CHECKPOINT_POPULATION_OFFSET(first, INDIVIDUAL_LEN),
+                                 checkpoint->population, local_size*INDIVIDUAL_LEN,
+                                 MPI_FLOAT, &checkpoint->requests[0]));
+    MPI_CHECK(MPI_File_iwrite_at(checkpoint->file,
+                                 CHECKPOINT_FITNESS_OFFSET(first, POPULATION_SIZE, INDIVIDUAL_LEN),
+                                 checkpoint->fitnesses, local_size,
+                                 MPI_FLOAT, &checkpoint->requests[1]));
+    checkpoint->pending = 2;
+
+    if(commRank == 0){
+        MPI_CHECK(MPI_File_iwrite_at(checkpoint->file, 0, header,
+                                     sizeof(CheckpointHeader), MPI_BYTE,
+                                     &checkpoint->requests[2]));
+        checkpoint->pending = 3;
+    }
+}
+
+bool readCheckpoint(const char *fileName, int commRank, int local_size,
+                    float *population_dev, float *population_dev_local,
+                    int *generationNumber, int *noChangeIter,
+                    float *bestFitness, float *previousBestFitness)
+{
+    MPI_File file;
+    if(MPI_File_open(MPI_COMM_WORLD, (char *)fileName, MPI_MODE_RDONLY,
+                     MPI_INFO_NULL, &file) != MPI_SUCCESS){
+        cerr << "Error while opening the file " << fileName << "!!!" << endl;
+        return false;
+    }
+
+    CheckpointHeader header;
+    MPI_CHECK(MPI_File_read_at_all(file, 0, &header, sizeof(CheckpointHeader),
+                                   MPI_BYTE, MPI_STATUS_IGNORE));
+    if(header.magic != CHECKPOINT_MAGIC
+       || header.version != CHECKPOINT_VERSION
+       || header.engine != CHECKPOINT_ENGINE_GA
+       || header.populationSize != POPULATION_SIZE
+       || header.individualLen != INDIVIDUAL_LEN){
+        cerr << "File " << fileName << " is not a compatible checkpoint!!!" << endl;
+        MPI_CHECK(MPI_File_close(&file));
+        return false;
+    }
+
+    //every process reads its slice, individual after individual
+    float *slice = new float[local_size*INDIVIDUAL_LEN];
+    float *staging = new float[local_size*INDIVIDUAL_LEN];
+    MPI_CHECK(MPI_File_read_at_all(file,
+                                   CHECKPOINT_POPULATION_OFFSET(commRank*local_size, INDIVIDUAL_LEN),
+                                   slice, local_size*INDIVIDUAL_LEN,
+                                   MPI_FLOAT, MPI_STATUS_IGNORE));
+    MPI_CHECK(MPI_File_close(&file));
+
+    //population on device is stored gene after gene
+    for(int k=0; k<local_size; k++)
+        for(int i=0; i<INDIVIDUAL_LEN; i++)
+            staging[i*local_size + k] = slice[k*INDIVIDUAL_LEN + i];
+
+    cudaMemcpy(population_dev_local, staging,
+               local_size*INDIVIDUAL_LEN*sizeof(float), cudaMemcpyHostToDevice);
+    check_cuda_error("Copying population slice to device");
+    delete [] slice;
+    delete [] staging;
+
+    for(int i=0; i<INDIVIDUAL_LEN; i++){
+        MPI_CHECK(
+            MPI_Gather(
+                &population_dev_local[i*local_size], local_size, MPI_FLOAT,
+                &population_dev[i*POPULATION_SIZE], local_size, MPI_FLOAT,
+                0, MPI_COMM_WORLD)
+        );
+    }
+
+    *generationNumber = header.generationNumber;
+    *noChangeIter = header.noChangeIter;
+    *bestFitness = header.bestFitness;
+    *previousBestFitness = header.previousBestFitness;
+
+    if(commRank == 0)
+        cout << "Restarting from checkpoint - generation " << *generationNumber << endl;
+
+    return true;
+}
+
 // Shut down MPI cleanly if something goes wrong
 void my_abort(int err)
 {
@@ -0,0 +1,88 @@
+/**
+
+Normalization of input points.
+
+x and f(x) are centered and scaled to [-1, 1], so powers of x stay of unit
+size, errors do not overflow float and the fixed mutation step is
+meaningful whatever the units of the data. The GA fits the polynomial in
+normalized space, its coefficients are transformed back by expanding
+    f(x) = yCenter + yScale * sum c'_k ((x - xCenter)/xScale)^k
+by the binomial theorem in double.
+
+*/
+
+#include <cmath>
+#include <algorithm>
+
+#include "config.h"
+#include "cpu_version.h"
+
+using namespace std;
+
+// Center and half range of @n values
+static void range(const float *values, long long n, double *center, double *scale)
+{
+    double low = INFINITY, high = -INFINITY;
+    for(long long i=0; i<n; i++){
+        low = min(low, (double)values[i]);
+        high = max(high, (double)values[i]);
+    }
+    *center = (low + high)/2;
+    *scale = high > low ? (high - low)/2 : 1;
+}
+
+Normalization normalizePoints(float *points, long long nPoints)
+{
+    Normalization n;
+    range(points, nPoints, &n.xCenter, &n.xScale);
+    range(&points[nPoints], nPoints, &n.yCenter, &n.yScale);
+
+    for(long long i=0; i<nPoints; i++){
+        points[i] = (points[i] - n.xCenter)/n.xScale;
+        points[nPoints + i] = (points[nPoints + i] - n.yCenter)/n.yScale;
+    }
+    return n;
+}
+
+// Coefficients of sum c_k (a*t + b)^k as polynomial in t
+static void substitute(const double *c, double a, double b, double *out)
+{
+    double binomial[INDIVIDUAL_LEN][INDIVIDUAL_LEN] = {{0}};
+    for(int k=0; k<INDIVIDUAL_LEN; k++){
+        binomial[k][0] = 1;
+        for(int j=1; j<=k; j++)
+            binomial[k][j] = binomial[k-1][j-1] + (j < k ? binomial[k-1][j] : 0);
+    }
+
+    for(int j=0; j<INDIVIDUAL_LEN; j++)
+        out[j] = 0;
+    for(int k=0; k<INDIVIDUAL_LEN; k++)
+        for(int j=0; j<=k; j++)
+            out[j] += c[k]*binomial[k][j]*pow(a, j)*pow(b, k - j);
+}
+
+void denormalizeCoefficients(const Normalization *n, const float *normalized,
+                             float *coefficients)
+{
+    //t = (x - xCenter)/xScale
+    double c[INDIVIDUAL_LEN], out[INDIVIDUAL_LEN];
+    for(int k=0; k<INDIVIDUAL_LEN; k++)
+        c[k] = normalized[k];
+    substitute(c, 1/n->xScale, -n->xCenter/n->xScale, out);
+
+    for(int k=0; k<INDIVIDUAL_LEN; k++)
+        coefficients[k] = n->yScale*out[k] + (k == 0 ? n->yCenter : 0);
+}
+
+void normalizeCoefficients(const Normalization *n, const float *coefficients,
+                           float *normalized)
+{
+    //x = xScale*t + xCenter
+    double c[INDIVIDUAL_LEN], out[INDIVIDUAL_LEN];
+    for(int k=0; k<INDIVIDUAL_LEN; k++)
+        c[k] = coefficients[k];
+    substitute(c, n->xScale, n->xCenter, out);
+
+    for(int k=0; k<INDIVIDUAL_LEN; k++)
+        normalized[k] = (out[k] - (k == 0 ? n->yCenter : 0))/n->yScale;
+}
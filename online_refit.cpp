@@ -0,0 +1,215 @@
+/**
+
+Online refit of polynomial approximation for continuously arriving points.
+
+Input (stdin or a growing file) is tailed, points are kept in sufficient
+statistics over a sliding window and/or with exponential forgetting. Every
+refit interval a few generations of the GA are run on the population left
+by the previous refit instead of evolving a random population from scratch.
+
+*/
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include <omp.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "cpu_version.h"
+
+using namespace std;
+
+/**
+    Points of the window, needed to remove points leaving the window
+    from statistics
+*/
+struct Window
+{
+    float *points;          // ring buffer of (x, f(x)) pairs
+    int capacity;           // 0 if all points are kept
+    long long count;        // number of points added so far
+    double oldestWeight;    // weight of point leaving the window
+};
+
+/**
+    Recomputes statistics of points in the window from scratch,
+    removes rounding errors accumulated by incremental updates
+*/
+static void recomputeStats(PolyStats *stats, const Window *window, double decay)
+{
+    clearPolyStats(stats);
+
+    long long n = min(window->count, (long long)window->capacity);
+    double w = 1;
+    for(long long age=0; age<n; age++){
+        long long pos = (window->count - 1 - age) % window->capacity;
+        addPolyStatsPoint(stats, window->points[2*pos], window->points[2*pos+1], w);
+        w *= decay;
+    }
+}
+
+static void addPoint(PolyStats *stats, Window *window, double decay, float x, float y)
+{
+    if(decay < 1)
+        decayPolyStats(stats, decay);
+
+    if(window->capacity > 0){
+        long long pos = window->count % window->capacity;
+
+        //oldest point leaves the window
+        if(window->count >= window->capacity){
+            addPolyStatsPoint(stats, window->points[2*pos], window->points[2*pos+1],
+                              -window->oldestWeight);
+        }
+        window->points[2*pos] = x;
+        window->points[2*pos+1] = y;
+    }
+
+    addPolyStatsPoint(stats, x, y, 1);
+    window->count++;
+
+    //every time the whole window is replaced
+    if(window->capacity > 0 && window->count % window->capacity == 0)
+        recomputeStats(stats, window, decay);
+}
+
+// Parses complete lines of @pending, returns number of points added
+static int parseLines(string *pending, PolyStats *stats, Window *window,
+                      double decay, bool flush)
+{
+    int added = 0;
+    size_t begin = 0;
+
+    while(true){
+        size_t end = pending->find('\n', begin);
+        if(end == string::npos){
+            if(!flush || begin >= pending->size())
+                break;
+            end = pending->size();
+        }
+
+        float x, y;
+        if(sscanf(pending->c_str() + begin, "%f %f", &x, &y) == 2){
+            addPoint(stats, window, decay, x, y);
+            added++;
+        }
+        begin = end + 1;
+    }
+
+    pending->erase(0, min(begin, pending->size()));
+    return added;
+}
+
+int runOnline(const Options *options, GAState *state)
+{
+    bool isStdin = strcmp(options->inputFile, "-") == 0;
+    int fd = isStdin ? STDIN_FILENO : open(options->inputFile, O_RDONLY);
+    if(fd < 0){
+        cerr << "Error while opening the file " << options->inputFile << "!!!" << endl;
+        return -1;
+    }
+
+    //regular file is followed as it grows, pipe ends when writer closes it
+    struct stat st;
+    bool follow = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+
+    PolyStats stats;
+    clearPolyStats(&stats);
+
+    Window window;
+    window.capacity = options->window;
+    window.points = window.capacity > 0 ? new float[2*window.capacity] : NULL;
+    window.count = 0;
+    window.oldestWeight = pow(options->decay, options->window);
+
+    Dataset data = {NULL, 0, NULL, &stats, NULL, NULL, NULL, 1};
+
+    string pending;
+    char buffer[1 << 16];
+    long long newPoints = 0;
+    int refits = 0;
+    bool eof = false;
+    double nextRefit = omp_get_wtime() + options->refitInterval;
+
+    while(!eof)
+    {
+        //wait for new data until next refit
+        double wait = nextRefit - omp_get_wtime();
+        bool ready = true;
+        if(!follow && wait > 0){
+            struct pollfd pfd = {fd, POLLIN, 0};
+            ready = poll(&pfd, 1, (int)(wait*1000) + 1) > 0;
+        }
+
+        if(ready){
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if(n > 0){
+                pending.append(buffer, n);
+                newPoints += parseLines(&pending, &stats, &window, options->decay, false);
+            }else if(n == 0 && !follow){
+                eof = true;
+                newPoints += parseLines(&pending, &stats, &window, options->decay, true);
+            }else if(n == 0 && wait > 0){
+                usleep(min(wait, 0.1)*1e6);
+            }else if(n < 0 && errno != EINTR && errno != EAGAIN){
+                cerr << "Error while reading " << options->inputFile << "!!!" << endl;
+                break;
+            }
+        }
+
+        if(omp_get_wtime() < nextRefit && !eof)
+            continue;
+        nextRefit = max(nextRefit + options->refitInterval,
+                        omp_get_wtime() + 0.5*options->refitInterval);
+
+        //nothing new to fit or not enough points to determine coefficients
+        if(newPoints == 0 || stats.weight < INDIVIDUAL_LEN)
+            continue;
+        newPoints = 0;
+
+        //fitness of population changed with data, restart convergence checks
+        state->noChangeIter = 0;
+        state->bestFitness = INFINITY;
+        state->previousBestFitness = INFINITY;
+
+        //first refit starts from random population, later ones are warm
+        int generations = refits == 0 ? maxGenerationNumber : options->refitGenerations;
+
+        double t1 = omp_get_wtime();
+        int done = 0;
+        if(options->solver == SOLVER_LS
+           || (options->solver == SOLVER_AUTO && isLinearProblem())){
+            //linear problem is solved directly from the statistics,
+            //elite is replaced unless it is already better on current data
+            evaluate(&data, state->population, 1, state->fitnesses);
+            state->bestFitness = state->fitnesses[0];
+            lamarckianRefinement(state, &data);
+        }else
+            done = runEngine(state, &data, generations, options);
+        double t2 = omp_get_wtime();
+        refits++;
+
+        cout << "Refit #" << refits << " points: " << window.count
+             << " generations: " << done
+             << " fitness: " << state->bestFitness << " coefficients:";
+        for(int j=0; j<INDIVIDUAL_LEN; j++)
+            cout << " " << state->population[j];
+        cout << " time: " << (t2-t1) << " s" << endl;
+    }
+
+    delete [] window.points;
+    if(!isStdin)
+        close(fd);
+
+    return 0;
+}
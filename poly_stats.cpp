@@ -0,0 +1,70 @@
+/**
+
+Sufficient statistics of points for polynomial model.
+
+Fitness of polynomial individual, i.e. sum of squared errors, can be expressed
+by power sums of the points, so it is evaluated in O(INDIVIDUAL_LEN^2)
+regardless of number of points. Statistics are updated incrementally when
+points arrive, leave the window or are forgotten.
+
+*/
+
+#include "config.h"
+#include "cpu_version.h"
+
+void clearPolyStats(PolyStats *stats)
+{
+    for(int k=0; k<2*INDIVIDUAL_LEN-1; k++)
+        stats->xPow[k] = 0;
+    for(int k=0; k<INDIVIDUAL_LEN; k++)
+        stats->yxPow[k] = 0;
+    stats->yy = 0;
+    stats->weight = 0;
+}
+
+void addPolyStatsPoint(PolyStats *stats, float x, float y, double w)
+{
+    double x_order = w;
+    for(int k=0; k<2*INDIVIDUAL_LEN-1; k++){
+        stats->xPow[k] += x_order;
+        if(k < INDIVIDUAL_LEN)
+            stats->yxPow[k] += x_order*y;
+        x_order *= x;
+    }
+    stats->yy += w*y*y;
+    stats->weight += w;
+}
+
+void decayPolyStats(PolyStats *stats, double lambda)
+{
+    for(int k=0; k<2*INDIVIDUAL_LEN-1; k++)
+        stats->xPow[k] *= lambda;
+    for(int k=0; k<INDIVIDUAL_LEN; k++)
+        stats->yxPow[k] *= lambda;
+    stats->yy *= lambda;
+    stats->weight *= lambda;
+}
+
+float *statsFitness(const PolyStats *stats, float *individuals, int size,
+                    float *current_fitnesses)
+{
+    #pragma omp parallel for schedule(static)
+    for(int i=0; i<size; i++)
+    {
+        const float *c = &individuals[i*INDIVIDUAL_LEN];
+        double sumError = stats->yy;
+
+        for(int j=0; j<INDIVIDUAL_LEN; j++)
+        {
+            double cross = 0;
+            for(int k=0; k<INDIVIDUAL_LEN; k++)
+                cross += c[k]*stats->xPow[j+k];
+            sumError += c[j]*(cross - 2*stats->yxPow[j]);
+        }
+
+        //rounding may push error of perfect fit below zero
+        current_fitnesses[i] = sumError > 0 ? sumError : 0;
+    }
+
+    return current_fitnesses;
+}
@@ -0,0 +1,122 @@
+/**
+
+Portfolio of GA configurations raced by successive halving.
+
+Mutation parameters and population size that work well differ per dataset.
+Several configurations are started at once, every one with its own
+population. In every rung each surviving configuration gets the same number
+of fitness evaluations, then the worse half is dropped and the budget of the
+next rung is doubled, so the time of the losers goes to the winners. Kernels
+of every configuration run on all threads, configurations take turns.
+
+*/
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+
+#include "config.h"
+#include "cpu_version.h"
+
+using namespace std;
+
+/**
+    Racing configuration with its population
+*/
+struct Contender
+{
+    Options options;
+    GAState *state;
+};
+
+// Fitter contender first
+static bool fitterContender(const Contender &a, const Contender &b)
+{
+    return a.state->bestFitness < b.state->bestFitness;
+}
+
+static void printContender(const Contender *contender)
+{
+    const Options *o = &contender->options;
+    cout << "population " << contender->state->size
+         << " mu/sigma of individuals " << o->muIndividuals << "/" << o->sigmaIndividuals
+         << " mu/sigma of genes " << o->muGenes << "/" << o->sigmaGenes;
+}
+
+GAState *runPortfolio(const Dataset *data, Options *options,
+                      const float *seeds, int nSeeds)
+{
+    int count = options->portfolio;
+    Contender *contenders = new Contender[count];
+
+    //first configuration is the default one, the others are random around it
+    for(int c=0; c<count; c++){
+        Options *o = &contenders[c].options;
+        *o = *options;
+        int size = options->populationSize;
+        if(c > 0){
+            o->muIndividuals = 2*frand();
+            o->sigmaIndividuals = 0.2 + 1.3*frand();
+            o->muGenes = 1.5*frand();
+            o->sigmaGenes = 0.2 + 1.3*frand();
+            size = max(4, options->populationSize >> (rngNext(&globalRng) % 4)) / 2 * 2;
+        }
+
+        GAState *state = createGAState(size);
+        if(seeds != NULL)
+            seedPopulation(state, seeds, nSeeds, options->seedPerturbation,
+                           options->seedRandomFraction);
+        else
+            initPopulation(state);
+        contenders[c].state = state;
+    }
+
+    float target = fitnessTarget(data);
+    long long rungEvaluations = portfolio_evaluations;
+    int alive = count;
+    int rung = 0;
+    bool finished = false;
+
+    while(alive > 1 && !finished)
+    {
+        for(int c=0; c<alive && !finished; c++){
+            GAState *state = contenders[c].state;
+            int generations = max(1LL, rungEvaluations/state->size);
+            generations = min(generations, maxGenerationNumber - state->generationNumber);
+            runGenerations(state, data, generations, &contenders[c].options);
+
+            //a contender reaching the target or the budget ends the race,
+            //so does a read error
+            finished = state->bestFitness <= target || budgetExhausted(state, options)
+                       || datasetFailed(data);
+        }
+
+        stable_sort(contenders, contenders + alive, fitterContender);
+        rung++;
+        cout << "Portfolio rung " << rung << " best fitness: "
+             << contenders[0].state->bestFitness << " (";
+        printContender(&contenders[0]);
+        cout << ")" << endl;
+
+        //worse half is dropped, survivors get twice the budget
+        int survivors = finished ? 1 : (alive + 1)/2;
+        for(int c=survivors; c<alive; c++)
+            freeGAState(contenders[c].state);
+        alive = survivors;
+        rungEvaluations *= 2;
+    }
+
+    //winner continues with its parameters
+    GAState *winner = contenders[0].state;
+    options->muIndividuals = contenders[0].options.muIndividuals;
+    options->sigmaIndividuals = contenders[0].options.sigmaIndividuals;
+    options->muGenes = contenders[0].options.muGenes;
+    options->sigmaGenes = contenders[0].options.sigmaGenes;
+    cout << "Portfolio winner: ";
+    printContender(&contenders[0]);
+    cout << endl;
+
+    delete [] contenders;
+    return winner;
+}
@@ -0,0 +1,51 @@
+/**
+    Precision policies of fitness kernels
+
+    Value is the type in which the model and its loss are computed at a
+    point, Sum the type of the sum of losses over points. Compensated
+    policy sums in float with Kahan correction kept per SIMD lane, so it
+    keeps float throughput and loses almost no digits over millions of
+    points.
+*/
+
+// Lanes of compensated sum, one vector of floats
+#define KAHAN_LANES 8
+
+struct FloatPrecision
+{
+    typedef float Value;
+    typedef float Sum;
+    static const bool compensated = false;
+};
+
+struct DoublePrecision
+{
+    typedef double Value;
+    typedef double Sum;
+    static const bool compensated = false;
+};
+
+// Float model, double accumulation
+struct MixedPrecision
+{
+    typedef float Value;
+    typedef double Sum;
+    static const bool compensated = false;
+};
+
+// Float model, compensated float accumulation
+struct KahanPrecision
+{
+    typedef float Value;
+    typedef float Sum;
+    static const bool compensated = true;
+};
+
+// Adds @value to Kahan sum @sum with compensation @c
+static inline void kahanAdd(float &sum, float &c, float value)
+{
+    float v = value - c;
+    float t = sum + v;
+    c = (t - sum) - v;
+    sum = t;
+}
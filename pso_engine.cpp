@@ -0,0 +1,319 @@
+/**
+
+Particle swarm engine.
+
+Every particle moves with velocity pulled towards its personal best position
+and towards the best position in its neighbourhood:
+
+v = w*v + c1*r1*(pbest - x) + c2*r2*(lbest - x),  x = x + v
+
+Neighbourhood is the whole swarm (global best) or the particle and its two
+neighbours in a ring, which keeps the swarm diverse for multimodal losses.
+
+Positions, velocities and personal bests are kept in SoA layout, one array
+per gene, so velocity and position update of a block of particles is one
+fused loop the compiler vectorizes. Blocks are updated in parallel, each
+with its own generator seeded from globalRng. There is no sorting; updated
+positions are transposed into newPopulation, so they are evaluated by the
+same fitness kernels as the GA.
+
+Population of GAState holds personal bests with the best particle first.
+
+*/
+
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <omp.h>
+
+#include "config.h"
+#include "cpu_version.h"
+
+using namespace std;
+
+// Particles updated by one task, random numbers of the block are drawn first
+#define PSO_BLOCK 256
+
+/**
+    Swarm state in SoA layout, gene j of particle i is at [j*size + i]
+*/
+struct PSOState
+{
+    int size;               // number of particles
+    float *x;               // positions
+    float *v;               // velocities
+    float *best;            // personal best positions
+    float *bestFitness;     // fitness of personal best positions
+    int *guide;             // particle whose best position attracts particle i
+};
+
+// Starts swarm at personal bests stored in evaluated population
+static PSOState *createPSOState(const GAState *state)
+{
+    int size = state->size;
+    PSOState *pso = new PSOState;
+    pso->size = size;
+    pso->x = new float[size*genomeLen];
+    pso->v = new float[size*genomeLen];
+    pso->best = new float[size*genomeLen];
+    pso->bestFitness = new float[size];
+    pso->guide = new int[size];
+
+    for(int i=0; i<size; i++){
+        for(int j=0; j<genomeLen; j++){
+            pso->x[j*size + i] = state->population[i*genomeLen + j];
+            pso->best[j*size + i] = pso->x[j*size + i];
+            pso->v[j*size + i] = 0;
+        }
+        pso->bestFitness[i] = state->fitnesses[i];
+    }
+
+    return pso;
+}
+
+void freePSOState(PSOState *pso)
+{
+    delete [] pso->x;
+    delete [] pso->v;
+    delete [] pso->best;
+    delete [] pso->bestFitness;
+    delete [] pso->guide;
+    delete pso;
+}
+
+//number of particles, then arrays in order of PSOState
+int psoStateBytes(const PSOState *pso)
+{
+    return sizeof(int) + pso->size*(3*genomeLen*sizeof(float) + sizeof(float) + sizeof(int));
+}
+
+void savePSOState(const PSOState *pso, char *buffer)
+{
+    int size = pso->size;
+    long long genes = (long long)size*genomeLen*sizeof(float);
+    memcpy(buffer, &size, sizeof(int));
+    buffer += sizeof(int);
+    memcpy(buffer, pso->x, genes);
+    memcpy(buffer + genes, pso->v, genes);
+    memcpy(buffer + 2*genes, pso->best, genes);
+    buffer += 3*genes;
+    memcpy(buffer, pso->bestFitness, size*sizeof(float));
+    memcpy(buffer + size*sizeof(float), pso->guide, size*sizeof(int));
+}
+
+PSOState *loadPSOState(const char *buffer, int bytes)
+{
+    int size;
+    if(bytes < (int)sizeof(int))
+        return NULL;
+    memcpy(&size, buffer, sizeof(int));
+    if(size < 1 || bytes != (int)(sizeof(int) + size*(3*genomeLen*sizeof(float)
+                                                      + sizeof(float) + sizeof(int))))
+        return NULL;
+
+    PSOState *pso = new PSOState;
+    pso->size = size;
+    pso->x = new float[size*genomeLen];
+    pso->v = new float[size*genomeLen];
+    pso->best = new float[size*genomeLen];
+    pso->bestFitness = new float[size];
+    pso->guide = new int[size];
+
+    long long genes = (long long)size*genomeLen*sizeof(float);
+    buffer += sizeof(int);
+    memcpy(pso->x, buffer, genes);
+    memcpy(pso->v, buffer + genes, genes);
+    memcpy(pso->best, buffer + 2*genes, genes);
+    buffer += 3*genes;
+    memcpy(pso->bestFitness, buffer, size*sizeof(float));
+    memcpy(pso->guide, buffer + size*sizeof(float), size*sizeof(int));
+    return pso;
+}
+
+// Finds particle with the best personal best in neighbourhood of every particle
+static void findGuides(PSOState *pso, bool ring)
+{
+    int size = pso->size;
+    const float *f = pso->bestFitness;
+
+    if(!ring){
+        int best = 0;
+        for(int i=1; i<size; i++)
+            if(f[i] < f[best])
+                best = i;
+        for(int i=0; i<size; i++)
+            pso->guide[i] = best;
+        return;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for(int i=0; i<size; i++){
+        int left = (i + size - 1) % size;
+        int right = (i + 1) % size;
+        int best = i;
+        if(f[left] < f[best])
+            best = left;
+        if(f[right] < f[best])
+            best = right;
+        pso->guide[i] = best;
+    }
+}
+
+// Copies personal bests into population of @state, the best one first,
+// returns index of the best particle
+static int storeBests(const PSOState *pso, GAState *state)
+{
+    int size = pso->size;
+    int best = 0;
+    for(int i=0; i<size; i++){
+        for(int j=0; j<genomeLen; j++)
+            state->population[i*genomeLen + j] = pso->best[j*size + i];
+        state->fitnesses[i] = pso->bestFitness[i];
+        if(pso->bestFitness[i] < pso->bestFitness[best])
+            best = i;
+    }
+
+    if(best != 0){
+        for(int j=0; j<genomeLen; j++){
+            swap(state->population[j], state->population[best*genomeLen + j]);
+            swap(state->steps[j], state->steps[best*genomeLen + j]);
+        }
+        swap(state->fitnesses[0], state->fitnesses[best]);
+    }
+    state->bestFitness = state->fitnesses[0];
+
+    return best;
+}
+
+int runParticleSwarm(GAState *state, const Dataset *data, int generations,
+                     const Options *options)
+{
+    int size = state->size;
+    float target = fitnessTarget(data);
+    int done = 0;
+
+    if(state->pso == NULL){
+        //random and restarted individuals do not have fitness yet
+        bool unknown = false;
+        for(int i=0; i<size; i++)
+            unknown |= state->fitnesses[i] == INFINITY;
+        if(unknown){
+            if(evaluateUntil(data, state->population, size, state->fitnesses,
+                             options->deadline) == NULL){
+                //partial sums are not fitness, only the elite keeps its known value
+                for(int i=1; i<size; i++)
+                    state->fitnesses[i] = INFINITY;
+                state->fitnesses[0] = state->bestFitness;
+                state->interrupted = !datasetFailed(data);
+                return 0;
+            }
+            state->evaluations += size;
+        }
+        state->pso = createPSOState(state);
+        storeBests(state->pso, state);
+    }
+    PSOState *pso = state->pso;
+
+    float *positions = state->newPopulation;
+    float *fitnesses = new float[size];
+    int nBlocks = (size + PSO_BLOCK - 1)/PSO_BLOCK;
+
+    while ( (done < generations)
+            && (state->bestFitness > target)
+            && (state->noChangeIter < maxConstIter)
+            && !budgetExhausted(state, options) )
+    {
+        state->generationNumber++;
+        done++;
+        double t = omp_get_wtime();
+
+        findGuides(pso, options->psoRing);
+        unsigned long long base = ((unsigned long long)rngNext(&globalRng) << 32)
+                                  | rngNext(&globalRng);
+
+        /** fused velocity and position update, block by block */
+        #pragma omp parallel for schedule(static)
+        for(int block=0; block<nBlocks; block++)
+        {
+            Rng rng;
+            seedRng(&rng, base + block);
+            int first = block*PSO_BLOCK;
+            int n = min(PSO_BLOCK, size - first);
+            float r1[PSO_BLOCK], r2[PSO_BLOCK], social[PSO_BLOCK];
+
+            for(int j=0; j<genomeLen; j++)
+            {
+                float *x = &pso->x[j*size + first];
+                float *v = &pso->v[j*size + first];
+                const float *best = &pso->best[j*size + first];
+
+                for(int k=0; k<n; k++){
+                    r1[k] = rngUniform(&rng);
+                    r2[k] = rngUniform(&rng);
+                    social[k] = pso->best[j*size + pso->guide[first + k]];
+                }
+
+                #pragma omp simd
+                for(int k=0; k<n; k++){
+                    float vk = pso_inertia*v[k]
+                             + pso_cognitive*r1[k]*(best[k] - x[k])
+                             + pso_social*r2[k]*(social[k] - x[k]);
+                    vk = min(max(vk, -pso_max_velocity), pso_max_velocity);
+                    v[k] = vk;
+                    x[k] += vk;
+                }
+
+                //AoS copy for fitness kernels
+                for(int k=0; k<n; k++)
+                    positions[(first + k)*genomeLen + j] = x[k];
+            }
+        }
+        t = lapPhase(state, PHASE_MUTATION, t);
+
+        /** evaluate new positions */
+        if(evaluateUntil(data, positions, size, fitnesses, options->deadline) == NULL){
+            //positions moved, but personal bests are still valid
+            state->generationNumber--;
+            done--;
+            state->interrupted = !datasetFailed(data);
+            lapPhase(state, PHASE_EVALUATION, t);
+            break;
+        }
+        state->evaluations += size;
+        t = lapPhase(state, PHASE_EVALUATION, t);
+
+        /** update personal bests */
+        #pragma omp parallel for schedule(static)
+        for(int i=0; i<size; i++){
+            if(!(fitnesses[i] < pso->bestFitness[i]))
+                continue;
+            pso->bestFitness[i] = fitnesses[i];
+            for(int j=0; j<genomeLen; j++)
+                pso->best[j*size + i] = pso->x[j*size + i];
+        }
+
+        int best = storeBests(pso, state);
+        trackConvergence(state, data);
+        t = lapPhase(state, PHASE_SELECTION, t);
+
+        //refined elite becomes personal best of the best particle
+        refinePopulation(state, data, options);
+        if(state->fitnesses[0] < pso->bestFitness[best]){
+            pso->bestFitness[best] = state->fitnesses[0];
+            for(int j=0; j<genomeLen; j++)
+                pso->best[j*size + best] = state->population[j];
+        }
+        lapPhase(state, PHASE_REFINEMENT, t);
+
+        //log message
+        #if defined(DEBUG)
+        cout << "#" << state->generationNumber<< " Fitness: " << state->bestFitness << \
+        " Iterations without change: " << state->noChangeIter << endl;
+        #endif
+    }
+
+    delete [] fitnesses;
+
+    return done;
+}
@@ -0,0 +1,54 @@
+/**
+
+Runtime selection of the small engine.
+
+The templated engine (small_engine.h) is instantiated for populations of
+128, 256 and 512 individuals of the built-in polynomial and for 128, 256
+and 512 points. The smallest instantiation holding all points is picked.
+
+*/
+
+#include <iostream>
+#include <omp.h>
+
+#include "config.h"
+#include "cpu_version.h"
+#include "small_engine.h"
+
+using namespace std;
+
+// Largest number of points of an instantiation
+#define SMALL_MAX_POINTS 512
+
+bool smallEngineSupports(const Dataset *data, int size)
+{
+    return (size == 128 || size == 256 || size == 512)
+        && genomeLen == INDIVIDUAL_LEN && userModel == NULL
+        && lossFunction == LOSS_SQUARED
+        && data->points != NULL && data->surface == NULL
+        && data->nPoints <= SMALL_MAX_POINTS;
+}
+
+template <int POP>
+static int runForPoints(GAState *state, const Dataset *data, int generations,
+                        const Options *options)
+{
+    if(data->nPoints <= 128)
+        return runSmall<POP, INDIVIDUAL_LEN, 128>(state, data, generations, options);
+    if(data->nPoints <= 256)
+        return runSmall<POP, INDIVIDUAL_LEN, 256>(state, data, generations, options);
+    return runSmall<POP, INDIVIDUAL_LEN, SMALL_MAX_POINTS>(state, data, generations, options);
+}
+
+int runSmallEngine(GAState *state, const Dataset *data, int generations,
+                   const Options *options)
+{
+    switch(state->size){
+        case 128:
+            return runForPoints<128>(state, data, generations, options);
+        case 256:
+            return runForPoints<256>(state, data, generations, options);
+        default:
+            return runForPoints<512>(state, data, generations, options);
+    }
+}
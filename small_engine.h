@@ -0,0 +1,159 @@
+/**
+    GA for tiny problems with compile-time sizes
+
+    Population size, genome length and capacity of points are template
+    parameters, so all arrays are std::array members of one object that stays
+    in L1 cache, every loop has a constant trip count and is unrolled or
+    vectorized by the compiler, and selection sorts by a bitonic sorting
+    network instead of std::sort. Points beyond the actual count are padded
+    with zero mask, so one instantiation serves every count up to POINTS.
+
+    Operators are those of the default GA: one-point crossover of the fitter
+    half and mutation by uniform noise of mutation_step. Individuals are
+    processed by a single thread, independent fits are meant to run side by
+    side.
+*/
+
+#include <array>
+#include <cmath>
+#include <algorithm>
+
+template <int POP, int GENES, int POINTS>
+struct SmallEngine
+{
+    std::array<float, POP*GENES> population, newPopulation;
+    std::array<float, POP> fitnesses;
+    std::array<int, POP> order;
+    std::array<float, POINTS> x, y, mask;
+
+    // Copies points and population of @state
+    void load(const GAState *state, const float *points, long long nPoints)
+    {
+        for(int pt=0; pt<POINTS; pt++){
+            x[pt] = pt < nPoints ? points[pt] : 0;
+            y[pt] = pt < nPoints ? points[nPoints + pt] : 0;
+            mask[pt] = pt < nPoints ? 1 : 0;
+        }
+        std::copy(state->population, state->population + POP*GENES, population.begin());
+        std::copy(state->fitnesses, state->fitnesses + POP, fitnesses.begin());
+    }
+
+    void store(GAState *state) const
+    {
+        std::copy(population.begin(), population.end(), state->population);
+        std::copy(fitnesses.begin(), fitnesses.end(), state->fitnesses);
+    }
+
+    // Squared error of all individuals, Horner scheme
+    void evaluate()
+    {
+        for(int i=0; i<POP; i++){
+            const float *c = &population[i*GENES];
+            float sumError = 0;
+            #pragma omp simd reduction(+:sumError)
+            for(int pt=0; pt<POINTS; pt++){
+                float value = c[GENES - 1];
+                for(int k=GENES-2; k>=0; k--)
+                    value = value*x[pt] + c[k];
+                float diff = value - y[pt];
+                sumError += mask[pt]*diff*diff;
+            }
+            fitnesses[i] = sumError;
+        }
+    }
+
+    // Children of random pairs of the fitter half replace the other half
+    void crossover()
+    {
+        const int half = POP/2;
+        for(int i=half; i<POP; i+=2){
+            int parent1 = rngNext(&globalRng) % half;
+            int parent2 = rngNext(&globalRng) % half;
+            int crosspoint = GENES > 2 ? rngNext(&globalRng) % (GENES - 2) + 1 : GENES - 1;
+            for(int j=0; j<GENES; j++){
+                int first = j < crosspoint ? parent1 : parent2;
+                int second = j < crosspoint ? parent2 : parent1;
+                population[i*GENES + j] = population[first*GENES + j];
+                if(i + 1 < POP)
+                    population[(i + 1)*GENES + j] = population[second*GENES + j];
+            }
+        }
+    }
+
+    // Every individual but the best one, same gene selection as mutation()
+    void mutate(const Options *options)
+    {
+        for(int i=1; i<POP; i++){
+            int mutNumber = nrand(options->muIndividuals, options->sigmaIndividuals);
+            for(int j=0; j<GENES; j++)
+                if(nrand(options->muGenes, options->sigmaGenes) < mutNumber)
+                    population[i*GENES + j] += mutation_step*(2*frand() - 1);
+        }
+    }
+
+    // Sorts individuals by fitness, bitonic network on power-of-two POP
+    void select()
+    {
+        for(int i=0; i<POP; i++){
+            order[i] = i;
+            if(std::isnan(fitnesses[i]))
+                fitnesses[i] = INFINITY;
+        }
+
+        for(int k=2; k<=POP; k*=2)
+            for(int j=k/2; j>0; j/=2)
+                for(int i=0; i<POP; i++){
+                    int l = i ^ j;
+                    if(l <= i)
+                        continue;
+                    float a = fitnesses[i], b = fitnesses[l];
+                    int ia = order[i], ib = order[l];
+                    bool exchange = (i & k) == 0 ? b < a : a < b;
+                    fitnesses[i] = exchange ? b : a;
+                    fitnesses[l] = exchange ? a : b;
+                    order[i] = exchange ? ib : ia;
+                    order[l] = exchange ? ia : ib;
+                }
+
+        for(int i=0; i<POP; i++)
+            for(int j=0; j<GENES; j++)
+                newPopulation[i*GENES + j] = population[order[i]*GENES + j];
+        population = newPopulation;
+    }
+};
+
+/**
+    Runs at most @generations generations of the GA on the small engine,
+    keeps the invariants of runGenerations(): fittest individual first with
+    its fitness in bestFitness, same stopping criteria
+*/
+template <int POP, int GENES, int POINTS>
+int runSmall(GAState *state, const Dataset *data, int generations, const Options *options)
+{
+    static_assert((POP & (POP - 1)) == 0, "sorting network needs power-of-two population");
+    SmallEngine<POP, GENES, POINTS> engine;
+    engine.load(state, data->points, data->nPoints);
+
+    float target = fitnessTarget(data);
+    int done = 0;
+    while( (done < generations)
+           && (state->bestFitness > target)
+           && (state->noChangeIter < maxConstIter)
+           && !budgetExhausted(state, options) )
+    {
+        state->generationNumber++;
+        done++;
+
+        engine.crossover();
+        engine.mutate(options);
+        engine.evaluate();
+        engine.select();
+
+        state->evaluations += POP;
+        state->bestFitness = engine.fitnesses[0];
+        trackConvergence(state, data);
+    }
+
+    engine.store(state);
+    return done;
+}
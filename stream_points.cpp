@@ -0,0 +1,312 @@
+/**
+
+Out-of-core evaluation of fitness for point sets larger than memory.
+
+Binary point file holds (x, f(x)) pairs of floats. Fitness is accumulated
+chunk by chunk - point loop is the outermost one, every chunk is used by all
+individuals before next chunk is needed. While compute threads work on one
+chunk, helper thread of the stream prefetches the next one into the second
+buffer using pread(), so reading of file overlaps with computation. The
+helper lives as long as the stream and is woken once per chunk. During the
+last chunk of a pass it reads chunk 0 of the next pass, so the next
+generation starts without waiting for the disk.
+
+*/
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "cpu_version.h"
+
+using namespace std;
+
+/**
+    Helper thread reading one chunk at a time on request
+*/
+struct Prefetcher
+{
+    thread worker;
+    mutex lock;
+    condition_variable wake;    // signals posted request, completion or quit
+    bool requested;             // request waits for the worker
+    bool done;                  // last request is completed
+    bool quit;
+    int buffer;                 // request: buffer, first point and count
+    long long first;
+    int count;
+    bool ok;                    // result of the last request
+};
+
+static bool readChunk(PointStream *stream, int b, long long first, int count);
+
+// Serves read requests until the stream is closed, runs in helper thread
+static void prefetchLoop(PointStream *stream)
+{
+    Prefetcher *p = stream->prefetcher;
+    unique_lock<mutex> guard(p->lock);
+    while(true){
+        p->wake.wait(guard, [p]{ return p->requested || p->quit; });
+        if(!p->requested)
+            return;
+        p->requested = false;
+
+        guard.unlock();
+        bool ok = readChunk(stream, p->buffer, p->first, p->count);
+        guard.lock();
+
+        p->ok = ok;
+        p->done = true;
+        p->wake.notify_all();
+    }
+}
+
+// Asks helper thread to read @count points from @first into buffer @b
+static void requestChunk(PointStream *stream, int b, long long first, int count)
+{
+    Prefetcher *p = stream->prefetcher;
+    lock_guard<mutex> guard(p->lock);
+    p->buffer = b;
+    p->first = first;
+    p->count = count;
+    p->requested = true;
+    p->done = false;
+    p->wake.notify_all();
+}
+
+// Waits for the requested chunk, returns false if it could not be read
+static bool waitChunk(PointStream *stream)
+{
+    Prefetcher *p = stream->prefetcher;
+    unique_lock<mutex> guard(p->lock);
+    p->wake.wait(guard, [p]{ return p->done; });
+    return p->ok;
+}
+
+// Waits for chunk 0 prefetched for the next pass and forgets it, so that
+// buffers can be used directly
+static void dropPrefetch(PointStream *stream)
+{
+    if(stream->nextBuffer >= 0){
+        waitChunk(stream);
+        stream->nextBuffer = -1;
+    }
+}
+
+PointStream *openPointStream(const char *name, int chunkPoints)
+{
+    int fd = open(name, O_RDONLY);
+    if(fd < 0){
+        cerr << "Error while opening the file " << name << "!!!" << endl;
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size % (2*sizeof(float)) != 0){
+        cerr << "File " << name << " is not a binary point file!!!" << endl;
+        close(fd);
+        return NULL;
+    }
+
+    PointStream *stream = new PointStream;
+    stream->fd = fd;
+    stream->count = st.st_size / (2*sizeof(float));
+    stream->chunkPoints = chunkPoints;
+
+    //chunk never needs to be bigger than the whole file
+    if(stream->count < stream->chunkPoints)
+        stream->chunkPoints = stream->count > 0 ? stream->count : 1;
+
+    for(int b=0; b<2; b++){
+        stream->buffers[b] = new float[2*stream->chunkPoints];
+        stream->raw[b] = new float[2*stream->chunkPoints];
+    }
+
+    //whole file is read sequentially in every generation
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    Prefetcher *p = new Prefetcher;
+    p->requested = false;
+    p->done = true;
+    p->quit = false;
+    p->ok = true;
+    stream->prefetcher = p;
+    p->worker = thread(prefetchLoop, stream);
+    stream->failed = false;
+    stream->nextBuffer = -1;
+
+    return stream;
+}
+
+void closePointStream(PointStream *stream)
+{
+    dropPrefetch(stream);
+    Prefetcher *p = stream->prefetcher;
+    {
+        lock_guard<mutex> guard(p->lock);
+        p->quit = true;
+        p->wake.notify_all();
+    }
+    p->worker.join();
+    delete p;
+
+    for(int b=0; b<2; b++){
+        delete [] stream->buffers[b];
+        delete [] stream->raw[b];
+    }
+    close(stream->fd);
+    delete stream;
+}
+
+bool pointsFitInMemory(long long count)
+{
+    //keep at least half of physical memory for the population and the system
+    long long memory = (long long)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+    return count*2*(long long)sizeof(float) < memory/2;
+}
+
+/**
+    Reads @count points starting at point @first into buffer @b,
+    x coordinates are stored first, f(x) values follow at offset chunkPoints
+*/
+static bool readChunk(PointStream *stream, int b, long long first, int count)
+{
+    char *dst = (char *)stream->raw[b];
+    size_t bytes = count*2*sizeof(float);
+    off_t offset = first*2*sizeof(float);
+
+    while(bytes > 0){
+        ssize_t n = pread(stream->fd, dst, bytes, offset);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        dst += n;
+        bytes -= n;
+        offset += n;
+    }
+
+    //deinterleave (x, f(x)) pairs
+    float *raw = stream->raw[b];
+    float *x = stream->buffers[b];
+    float *y = stream->buffers[b] + stream->chunkPoints;
+    for(int pt=0; pt<count; pt++){
+        x[pt] = raw[2*pt];
+        y[pt] = raw[2*pt + 1];
+    }
+
+    return true;
+}
+
+float *loadPointStream(PointStream *stream)
+{
+    long long count = stream->count;
+    float *points = new float[2*count];
+    dropPrefetch(stream);
+
+    for(long long first=0; first<count; first+=stream->chunkPoints){
+        int n = min((long long)stream->chunkPoints, count - first);
+        if(!readChunk(stream, 0, first, n)){
+            cerr << "Error while reading binary point file!!!" << endl;
+            delete [] points;
+            return NULL;
+        }
+        memcpy(&points[first], stream->buffers[0], n*sizeof(float));
+        memcpy(&points[count + first], stream->buffers[0] + stream->chunkPoints,
+               n*sizeof(float));
+    }
+
+    return points;
+}
+
+float *streamFitness(PointStream *stream, float *individuals, int size,
+                     float *current_fitnesses, double deadline)
+{
+    for(int i=0; i<size; i++)
+        current_fitnesses[i] = 0;
+
+    if(stream->failed)
+        return NULL;
+
+    long long count = stream->count;
+    int chunk = stream->chunkPoints;
+    long long nChunks = (count + chunk - 1) / chunk;
+    if(nChunks == 0)
+        return current_fitnesses;
+
+    //chunk 0 was usually prefetched during the last chunk of previous pass
+    int start = stream->nextBuffer;
+    bool ok;
+    if(start >= 0){
+        ok = waitChunk(stream);
+        stream->nextBuffer = -1;
+    }else{
+        start = 0;
+        ok = readChunk(stream, 0, 0, min((long long)chunk, count));
+    }
+
+    for(long long k=0; k<nChunks && ok; k++){
+        int b = (start + k) % 2;
+        int n = min((long long)chunk, count - k*chunk);
+
+        //prefetch next chunk into the other buffer, after the last chunk
+        //the next pass starts again from chunk 0
+        bool last = k+1 == nChunks;
+        long long next = last ? 0 : (k+1)*chunk;
+        requestChunk(stream, 1-b, next, min((long long)chunk, count - next));
+
+        bool complete = fitnessChunk(individuals, size, stream->buffers[b],
+                                     stream->buffers[b] + chunk, NULL, n,
+                                     current_fitnesses, deadline);
+
+        //chunk 0 of the next pass is waited for when the pass starts
+        if(last)
+            stream->nextBuffer = 1-b;
+        else
+            ok = waitChunk(stream);
+
+        //pass over the file is given up when time runs out
+        if(!complete)
+            return NULL;
+    }
+
+    //failed read ends the pass and is reported by stream->failed
+    if(!ok){
+        cerr << "Error while reading binary point file!!!" << endl;
+        stream->failed = true;
+        return NULL;
+    }
+
+    return current_fitnesses;
+}
+
+bool streamPolyStats(PointStream *stream, PolyStats *stats)
+{
+    clearPolyStats(stats);
+    dropPrefetch(stream);
+
+    long long count = stream->count;
+    int chunk = stream->chunkPoints;
+    for(long long first=0; first<count; first+=chunk){
+        int n = min((long long)chunk, count - first);
+        if(!readChunk(stream, 0, first, n)){
+            cerr << "Error while reading binary point file!!!" << endl;
+            return false;
+        }
+
+        const float *x = stream->buffers[0];
+        const float *y = stream->buffers[0] + chunk;
+        for(int pt=0; pt<n; pt++)
+            addPolyStatsPoint(stats, x[pt], y[pt], 1);
+    }
+    return true;
+}
@@ -0,0 +1,275 @@
+/**
+
+Multivariate polynomial surfaces.
+
+Input text file has d coordinates and the value on every line. Monomials of
+total degree at most p are generated at startup in graded order
+(1, x1, x2, x1^2, x1*x2, x2^2, ...) and every point is expanded into their
+values once. Feature matrix is stored by columns, so a block of points of one
+monomial is contiguous and the model value of a block is accumulated by one
+vectorized loop per monomial. A tile of individuals shares every loaded
+feature block.
+
+*/
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+
+#include "config.h"
+#include "cpu_version.h"
+#include "surface.h"
+#include "loss.h"
+
+using namespace std;
+
+int surfaceTile = 4;
+
+int monomialCount(int dims, int degree)
+{
+    //binomial coefficient (dims + degree choose degree), it grows with i,
+    //so counting stops as soon as the genome could not hold it
+    long long count = 1;
+    for(int i=1; i<=degree; i++){
+        count = count*(dims + i)/i;
+        if(count > MAX_GENOME_LEN)
+            return MAX_GENOME_LEN + 1;
+    }
+    return count;
+}
+
+// Appends all monomials of x_k, ..., x_d with total degree @remaining
+static void addMonomials(Surface *surface, int *exponents, int k, int remaining, int *term)
+{
+    if(k == surface->dims - 1){
+        exponents[k] = remaining;
+        memcpy(&surface->exponents[*term*surface->dims], exponents,
+               surface->dims*sizeof(int));
+        (*term)++;
+        return;
+    }
+
+    for(int e=remaining; e>=0; e--){
+        exponents[k] = e;
+        addMonomials(surface, exponents, k + 1, remaining - e, term);
+    }
+}
+
+Surface *readSurface(const char *name, int dims, int degree)
+{
+    //exponents and features are sized by the number of terms
+    if(dims < 1 || dims > MAX_GENOME_LEN || monomialCount(dims, degree) > MAX_GENOME_LEN){
+        cerr << "Surface has more than MAX_GENOME_LEN terms!!!" << endl;
+        return NULL;
+    }
+
+    FILE *file = fopen(name,"r");
+    if (file == NULL){
+        cerr << "Error while opening the file " << name << "!!!" << endl;
+        return NULL;
+    }
+
+    //x1 ... xd z on each line
+    long long capacity = 1024;
+    float *coordinates = new float[capacity*(dims + 1)];
+    long long k = 0;
+    bool complete = true;
+    while(complete){
+        if(k == capacity){
+            float *grown = new float[2*capacity*(dims + 1)];
+            memcpy(grown, coordinates, capacity*(dims + 1)*sizeof(float));
+            delete [] coordinates;
+            coordinates = grown;
+            capacity *= 2;
+        }
+        for(int j=0; j<=dims && complete; j++)
+            complete = fscanf(file, "%f", &coordinates[k*(dims + 1) + j]) == 1;
+        if(complete)
+            k++;
+    }
+    fclose(file);
+
+    if(k == 0){
+        cerr << "No point found in the file " << name << "!!!" << endl;
+        delete [] coordinates;
+        return NULL;
+    }
+
+    Surface *surface = new Surface;
+    surface->dims = dims;
+    surface->degree = degree;
+    surface->nTerms = monomialCount(dims, degree);
+    surface->exponents = new int[surface->nTerms*dims];
+    surface->nPoints = k;
+    surface->features = new float[surface->nTerms*k];
+    surface->z = new float[k];
+
+    int exponents[MAX_GENOME_LEN];
+    int term = 0;
+    for(int total=0; total<=degree; total++)
+        addMonomials(surface, exponents, 0, total, &term);
+
+    #pragma omp parallel for schedule(static)
+    for(long long pt=0; pt<k; pt++){
+        const float *x = &coordinates[pt*(dims + 1)];
+        surface->z[pt] = x[dims];
+        for(int m=0; m<surface->nTerms; m++){
+            double value = 1;
+            for(int j=0; j<dims; j++)
+                for(int e=0; e<surface->exponents[m*dims + j]; e++)
+                    value *= x[j];
+            surface->features[m*k + pt] = value;
+        }
+    }
+
+    delete [] coordinates;
+    cout << "Reading file - success!" << endl;
+    return surface;
+}
+
+void freeSurface(Surface *surface)
+{
+    delete [] surface->exponents;
+    delete [] surface->features;
+    delete [] surface->z;
+    delete surface;
+}
+
+void printMonomial(const Surface *surface, int term)
+{
+    const int *e = &surface->exponents[term*surface->dims];
+    bool first = true;
+    for(int j=0; j<surface->dims; j++){
+        if(e[j] == 0)
+            continue;
+        cout << (first ? "" : "*") << "x" << j + 1;
+        if(e[j] > 1)
+            cout << "^" << e[j];
+        first = false;
+    }
+    if(first)
+        cout << "1";
+}
+
+template <class Loss>
+static float *surfaceKernel(const Loss &loss, const Surface *surface,
+                            const float *individuals, int size, const float *weights,
+                            float *fitnesses, double deadline)
+{
+    const long long nPoints = surface->nPoints;
+    const int nTerms = surface->nTerms;
+    const int tileSize = surfaceTile;
+    int nTiles = (size + tileSize - 1)/tileSize;
+    long long checkEvery = max(1LL, 65536/(nPoints*tileSize));
+    bool expired = false;
+
+    #pragma omp parallel for schedule(static)
+    for(int tile=0; tile<nTiles; tile++)
+    {
+        bool skip;
+        if(deadline > 0 && tile % checkEvery == 0 && omp_get_wtime() >= deadline){
+            #pragma omp atomic write
+            expired = true;
+        }
+        #pragma omp atomic read
+        skip = expired;
+        if(skip)
+            continue;
+
+        int first = tile*tileSize;
+        int n = min(tileSize, size - first);
+        float value[SURFACE_MAX_TILE][SURFACE_BLOCK];
+        float sumError[SURFACE_MAX_TILE] = {0};
+
+        for(long long block=0; block<nPoints; block+=SURFACE_BLOCK)
+        {
+            int count = min((long long)SURFACE_BLOCK, nPoints - block);
+            for(int t=0; t<n; t++)
+                for(int pt=0; pt<count; pt++)
+                    value[t][pt] = 0;
+
+            //every feature block is loaded once for the whole tile
+            for(int m=0; m<nTerms; m++){
+                const float *f = &surface->features[m*nPoints + block];
+                for(int t=0; t<n; t++){
+                    float c = individuals[(first + t)*genomeLen + m];
+                    float *v = value[t];
+                    #pragma omp simd
+                    for(int pt=0; pt<count; pt++)
+                        v[pt] += c*f[pt];
+                }
+            }
+
+            const float *z = &surface->z[block];
+            const float *w = weights != NULL ? &weights[block] : NULL;
+            for(int t=0; t<n; t++)
+                for(int pt=0; pt<count; pt++){
+                    float diff = value[t][pt] - z[pt];
+                    sumError[t] += Loss::weighted ? w[pt]*loss(diff) : loss(diff);
+                }
+        }
+
+        for(int t=0; t<n; t++)
+            fitnesses[first + t] = sumError[t];
+    }
+
+    return expired ? NULL : fitnesses;
+}
+
+float *surfaceFitness(const Surface *surface, float *individuals, int size,
+                      const float *weights, float *fitnesses, double deadline)
+{
+    switch(lossFunction){
+        case LOSS_ABSOLUTE:
+            return surfaceKernel(AbsoluteLoss(), surface, individuals, size, weights,
+                                 fitnesses, deadline);
+        case LOSS_HUBER:
+            return surfaceKernel(HuberLoss(lossScale), surface, individuals, size, weights,
+                                 fitnesses, deadline);
+        case LOSS_CAUCHY:
+            return surfaceKernel(CauchyLoss(lossScale), surface, individuals, size, weights,
+                                 fitnesses, deadline);
+        case LOSS_WEIGHTED:
+            return surfaceKernel(WeightedSquaredLoss(), surface, individuals, size, weights,
+                                 fitnesses, deadline);
+        default:
+            return surfaceKernel(SquaredLoss(), surface, individuals, size, weights,
+                                 fitnesses, deadline);
+    }
+}
+
+bool surfaceLeastSquares(const Surface *surface, const float *weights,
+                         float *coefficients)
+{
+    const long long nPoints = surface->nPoints;
+    const int n = surface->nTerms;
+    double A[MAX_GENOME_LEN*MAX_GENOME_LEN] = {0}, b[MAX_GENOME_LEN] = {0};
+    double c[MAX_GENOME_LEN];
+
+    //F^T W F c = F^T W z
+    for(int j=0; j<n; j++){
+        const float *fj = &surface->features[j*nPoints];
+        for(int k=0; k<=j; k++){
+            const float *fk = &surface->features[k*nPoints];
+            double sum = 0;
+            for(long long pt=0; pt<nPoints; pt++)
+                sum += (weights != NULL ? weights[pt] : 1.0)*fj[pt]*fk[pt];
+            A[j*n + k] = sum;
+            A[k*n + j] = sum;
+        }
+        double sum = 0;
+        for(long long pt=0; pt<nPoints; pt++)
+            sum += (weights != NULL ? weights[pt] : 1.0)*fj[pt]*surface->z[pt];
+        b[j] = sum;
+    }
+
+    if(!choleskySolve(A, b, n, c))
+        return false;
+
+    for(int j=0; j<n; j++)
+        coefficients[j] = c[j];
+    return true;
+}
@@ -0,0 +1,50 @@
+/**
+    Multivariate polynomial model z = sum c_m * x1^e1 * ... * xd^ed over
+    all monomials of total degree at most @degree
+
+    Monomials are generated once, ordered by total degree, and every point is
+    expanded into the values of all monomials (feature matrix). Model is then
+    linear in coefficients, so fitness of an individual is a dot product of
+    its coefficients with the feature columns of a block of points.
+*/
+
+// Points of one block and maximum individuals sharing the loads of feature block
+#define SURFACE_BLOCK 64
+#define SURFACE_MAX_TILE 8
+
+// Individuals sharing the loads of feature block, at most SURFACE_MAX_TILE,
+// results do not depend on it
+extern int surfaceTile;
+
+struct Surface
+{
+    int dims;               // input dimensions of a point
+    int degree;             // maximum total degree of monomials
+    int nTerms;             // number of monomials == coefficients
+    int *exponents;         // exponent of x_k in monomial m at [m*dims + k]
+    long long nPoints;
+    float *features;        // monomial m of point pt at [m*nPoints + pt]
+    float *z;               // values to approximate
+};
+
+// Number of monomials of @dims variables with total degree at most @degree,
+// MAX_GENOME_LEN + 1 if there are more than MAX_GENOME_LEN of them
+int monomialCount(int dims, int degree);
+
+// Reads text file with @dims coordinates and the value on each line,
+// @dims is at most MAX_GENOME_LEN
+Surface *readSurface(const char *name, int dims, int degree);
+
+void freeSurface(Surface *surface);
+
+// Prints monomial of coefficient c@term, e.g. x1^2*x2
+void printMonomial(const Surface *surface, int term);
+
+// Evaluates fitness of @size individuals, NULL if @deadline passed,
+// @weights of points are used by LOSS_WEIGHTED only
+float *surfaceFitness(const Surface *surface, float *individuals, int size,
+                      const float *weights, float *fitnesses, double deadline);
+
+// Solves (weighted) normal equations of the feature matrix, false if singular
+bool surfaceLeastSquares(const Surface *surface, const float *weights,
+                         float *coefficients);